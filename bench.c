@@ -0,0 +1,643 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "treemap.h"
+#include "treemap_gen.h"
+
+//Suite de benchmarks de TreeMap
+//Compilar: ./bench.sh (o gcc -O2 -pthread bench.c treemap.c -o bench -lm)
+//Uso: ./bench [--min n] [--max n] [--layouts a,b] [--dists a,b]
+//             [--threads t] [--words archivo]
+//
+//Por cada representacion (layout), distribucion de claves y tamano (potencias
+//de 10 entre --min y --max) mide insert, search, upper, batch, iterate y erase
+//(en los TreeMap tambien insert_hint, open y file_search).
+//Cada configuracion corre en un proceso hijo para que su peak RSS sea propio.
+//La salida es una linea JSON por medicion:
+//  {"layout":"binary","dist":"random","n":1000,"op":"search",
+//   "ops_per_sec":...,"p50_ns":...,"p99_ns":...,"peak_rss_kb":...}
+//Con --threads t ademas mide, con --max claves y de 1 a t hilos, las
+//busquedas del mapa concurrente y reduceTreeMap/buildParallelTreeMap.
+
+#define MAX_SAMPLES 10000
+#define BATCH 256
+
+/* ---- utilidades ---- */
+
+unsigned long long rng_state = 88172645463325252ULL;
+
+unsigned long long next_random(){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+long peak_rss_kb(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void shuffle(void** items, int n){
+    for(int i=n-1; i>0; i--){
+        int j = next_random() % (i+1);
+        void* aux = items[i]; items[i] = items[j]; items[j] = aux;
+    }
+}
+
+//generador zipfiano (theta=0.99) de Gray et al.: O(n) para preparar y
+//O(1) por muestra; retorna un rango en [0, n)
+typedef struct{
+    int n;
+    double theta, alpha, zetan, eta;
+}Zipf;
+
+void zipf_init(Zipf* z, int n, double theta){
+    double zeta2 = 1.0 + pow(0.5, theta);
+    z->n = n;
+    z->theta = theta;
+    z->zetan = 0;
+    for(int i=1; i<=n; i++) z->zetan += 1.0 / pow(i, theta);
+    z->alpha = 1.0 / (1.0 - theta);
+    z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+int zipf_next(Zipf* z){
+    double u = (next_random() >> 11) * (1.0 / 9007199254740992.0);
+    double uz = u * z->zetan;
+    if(uz < 1.0) return 0;
+    if(uz < 1.0 + pow(0.5, z->theta)) return 1;
+    int r = (int) (z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return r < z->n ? r : z->n - 1;
+}
+
+/* ---- representaciones a comparar ---- */
+
+int lower_than_int(void* key1, void* key2){
+    int k1 = *((int*) (key1));
+    int k2 = *((int*) (key2));
+    return k1<k2;
+}
+
+int compare_string(void* key1, void* key2){
+    return strcmp((char*) key1, (char*) key2);
+}
+
+size_t encode_int(void* key, void* buf, size_t cap){
+    if(cap >= sizeof(int)) memcpy(buf, key, sizeof(int));
+    return sizeof(int);
+}
+
+size_t encode_string(void* key, void* buf, size_t cap){
+    size_t len = strlen((char*) key) + 1;
+    if(cap >= len) memcpy(buf, key, len);
+    return len;
+}
+
+#define int_lt(a, b) ((a) < (b))
+TREEMAP_INIT(gmap, int, int*, int_lt)
+
+typedef struct{
+    const char* name;
+    int ints;     //acepta claves int
+    int strings;  //acepta claves char*
+    void* (*create)(int strings);
+    void (*destroy)(void* map);
+    void (*insert)(void* map, void* key);
+    int (*search)(void* map, void* key);
+    int (*upper)(void* map, void* key);
+    int (*batch)(void* map, void** keys, int n); //NULL si no existe
+    int snapshot; //es un TreeMap: se puede guardar con saveTreeMap
+    int (*first)(void* map);
+    int (*next)(void* map);
+    void (*erase)(void* map, void* key);
+}Layout;
+
+void* tm_create(int strings){
+    return strings ? createTreeMapCompare(compare_string) : createTreeMap(lower_than_int);
+}
+void* bt_create(int strings){
+    return strings ? createBTreeMapCompare(compare_string) : createBTreeMap(lower_than_int);
+}
+void* st_create(int strings){ return createStringTreeMap(); }
+unsigned long hash_int(void* key){
+    return (unsigned long) *((int*) key);
+}
+
+unsigned long hash_string(void* key){ //FNV-1a
+    unsigned long h = 14695981039346656037UL;
+    for(const unsigned char* c = key; *c; c++) h = (h ^ *c) * 1099511628211UL;
+    return h;
+}
+
+void* ix_create(int strings){
+    TreeMap* map = tm_create(strings);
+    indexTreeMap(map, strings ? hash_string : hash_int);
+    return map;
+}
+void* sp_create(int strings){
+    return strings ? createSplayTreeMapCompare(compare_string) : createSplayTreeMap(lower_than_int);
+}
+void* th_create(int strings){
+    TreeMap* map = tm_create(strings);
+    threadTreeMap(map);
+    return map;
+}
+void tm_destroy(void* map){ destroyTreeMap(map); }
+void tm_insert(void* map, void* key){ insertTreeMap(map, key, key); }
+int tm_search(void* map, void* key){ return searchTreeMap(map, key) != NULL; }
+int tm_upper(void* map, void* key){ return upperBound(map, key) != NULL; }
+int tm_batch(void* map, void** keys, int n){
+    Pair* out[BATCH];
+    return searchBatchTreeMap(map, keys, n, out);
+}
+int tm_first(void* map){ return firstTreeMap(map) != NULL; }
+int tm_next(void* map){ return nextTreeMap(map) != NULL; }
+void tm_erase(void* map, void* key){ eraseTreeMap(map, key); }
+
+void* im_create(int strings){ return createIntTreeMap(); }
+void im_destroy(void* map){ destroyIntTreeMap(map); }
+void im_insert(void* map, void* key){ insertIntTreeMap(map, *((int*) key), key); }
+int im_search(void* map, void* key){ return searchIntTreeMap(map, *((int*) key)) != NULL; }
+int im_upper(void* map, void* key){ return upperBoundIntTreeMap(map, *((int*) key), NULL); }
+int im_first(void* map){ return firstIntTreeMap(map, NULL); }
+int im_next(void* map){ return nextIntTreeMap(map, NULL); }
+void im_erase(void* map, void* key){ eraseIntTreeMap(map, *((int*) key)); }
+
+void* pm_create(int strings){ return createPersistentTreeMap(lower_than_int); }
+void pm_destroy(void* map){ destroyPersistentTreeMap(map); }
+void pm_insert(void* map, void* key){ insertPersistentTreeMap(map, key, key); }
+int pm_search(void* map, void* key){ return searchPersistentTreeMap(map, key) != NULL; }
+int pm_upper(void* map, void* key){ return upperBoundPersistentTreeMap(map, key) != NULL; }
+int pm_first(void* map){ return firstPersistentTreeMap(map) != NULL; }
+int pm_next(void* map){ return nextPersistentTreeMap(map) != NULL; }
+void pm_erase(void* map, void* key){ erasePersistentTreeMap(map, key); }
+
+gmap_node_t* gen_cursor;
+void* gm_create(int strings){ return gmap_create(); }
+void gm_destroy(void* map){ gmap_destroy(map); }
+void gm_insert(void* map, void* key){ gmap_put(map, *((int*) key), key); }
+int gm_search(void* map, void* key){ return gmap_get(map, *((int*) key)) != NULL; }
+int gm_upper(void* map, void* key){ return gmap_upper_bound(map, *((int*) key)) != NULL; }
+int gm_first(void* map){ return (gen_cursor = gmap_first(map)) != NULL; }
+int gm_next(void* map){ return (gen_cursor = gmap_next(gen_cursor)) != NULL; }
+void gm_erase(void* map, void* key){ gmap_del(map, *((int*) key)); }
+
+Layout layouts[] = {
+    {"binary", 1, 1, tm_create, tm_destroy, tm_insert, tm_search, tm_upper, tm_batch, 1, tm_first, tm_next, tm_erase},
+    {"threaded", 1, 1, th_create, tm_destroy, tm_insert, tm_search, tm_upper, tm_batch, 1, tm_first, tm_next, tm_erase},
+    {"indexed", 1, 1, ix_create, tm_destroy, tm_insert, tm_search, tm_upper, tm_batch, 1, tm_first, tm_next, tm_erase},
+    {"splay", 1, 1, sp_create, tm_destroy, tm_insert, tm_search, tm_upper, tm_batch, 1, tm_first, tm_next, tm_erase},
+    {"btree", 1, 1, bt_create, tm_destroy, tm_insert, tm_search, tm_upper, tm_batch, 1, tm_first, tm_next, tm_erase},
+    {"prefix", 0, 1, st_create, tm_destroy, tm_insert, tm_search, tm_upper, tm_batch, 1, tm_first, tm_next, tm_erase},
+    {"int64", 1, 0, im_create, im_destroy, im_insert, im_search, im_upper, NULL, 0, im_first, im_next, im_erase},
+    {"persistent", 1, 0, pm_create, pm_destroy, pm_insert, pm_search, pm_upper, NULL, 0, pm_first, pm_next, pm_erase},
+    {"generic", 1, 0, gm_create, gm_destroy, gm_insert, gm_search, gm_upper, NULL, 0, gm_first, gm_next, gm_erase},
+};
+
+const char* dists[] = {"sorted", "reverse", "random", "zipf", "hot", "string"};
+
+#define N_LAYOUTS ((int) (sizeof(layouts) / sizeof(layouts[0])))
+#define N_DISTS ((int) (sizeof(dists) / sizeof(dists[0])))
+
+/* ---- claves ---- */
+
+//palabras de un archivo (una por linea) o, si no hay, palabras sinteticas
+//armadas con silabas del espanol, que comparten prefijos como un diccionario
+char** load_words(const char* path, int* n){
+    char** words = (char**) malloc(sizeof(char*) * (*n));
+    int count = 0;
+    char line[256];
+    FILE* f = path != NULL ? fopen(path, "r") : NULL;
+    if(f != NULL){
+        while(count < *n && fgets(line, sizeof(line), f) != NULL){
+            line[strcspn(line, "\r\n")] = '\0';
+            if(line[0] != '\0') words[count++] = strdup(line);
+        }
+        fclose(f);
+        *n = count;
+        return words;
+    }
+    const char* syllables[] = {"ca","sa","co","ce","se","ma","pa","ra","to","li","na",
+                               "des","con","in","tra","pre","mente","cion","dad","ble"};
+    int s = sizeof(syllables) / sizeof(syllables[0]);
+    for(; count < *n; count++){
+        int len = 0, parts = 2 + next_random() % 5;
+        for(int j=0; j<parts; j++){
+            int k = next_random() % s;
+            if(next_random() % 2) k = k % 5; //sesgo hacia silabas frecuentes
+            len += sprintf(line + len, "%s", syllables[k]);
+        }
+        sprintf(line + len, "%d", count); //sin repetidos
+        words[count] = strdup(line);
+    }
+    return words;
+}
+
+//orden de insercion, consultas y orden de eliminacion para una distribucion
+typedef struct{
+    int n;
+    void** inserts;
+    void** probes;
+    void** erases;
+}Workload;
+
+void make_workload(Workload* w, const char* dist, int n, const char* words_path){
+    w->inserts = (void**) malloc(sizeof(void*) * n);
+    w->probes = (void**) malloc(sizeof(void*) * n);
+    w->erases = (void**) malloc(sizeof(void*) * n);
+
+    if(strcmp(dist, "string") == 0){
+        char** words = load_words(words_path, &n);
+        for(int i=0; i<n; i++) w->inserts[i] = words[i];
+        free(words);
+    }else{
+        int* keys = (int*) malloc(sizeof(int) * n);
+        for(int i=0; i<n; i++){
+            keys[i] = i;
+            w->inserts[i] = &keys[i];
+        }
+        if(strcmp(dist, "reverse") == 0){
+            for(int i=0; i<n; i++) w->inserts[i] = &keys[n-1-i];
+        }else if(strcmp(dist, "sorted") != 0){
+            shuffle(w->inserts, n);
+        }
+    }
+    w->n = n;
+
+    memcpy(w->erases, w->inserts, sizeof(void*) * n);
+    if(strcmp(dist, "sorted") != 0 && strcmp(dist, "reverse") != 0) shuffle(w->erases, n);
+
+    if(strcmp(dist, "zipf") == 0){ //consultas sesgadas hacia pocas claves calientes
+        Zipf z;
+        zipf_init(&z, n, 0.99);
+        for(int i=0; i<n; i++) w->probes[i] = w->inserts[zipf_next(&z)];
+    }else if(strcmp(dist, "hot") == 0){ //90% de las consultas a 4096 claves
+        int hot = n < 4096 ? n : 4096;
+        for(int i=0; i<n; i++){
+            int r = next_random() % 10 ? next_random() % hot : next_random() % n;
+            w->probes[i] = w->inserts[r];
+        }
+    }else{
+        memcpy(w->probes, w->inserts, sizeof(void*) * n);
+        shuffle(w->probes, n);
+    }
+}
+
+/* ---- mediciones ---- */
+
+int compare_double(const void* a, const void* b){
+    double x = *((double*) a), y = *((double*) b);
+    return (x > y) - (x < y);
+}
+
+void emit(const Layout* layout, const char* dist, int n, const char* op,
+          long ops, double secs, double* samples, int count){
+    qsort(samples, count, sizeof(double), compare_double);
+    double p50 = count > 0 ? samples[count / 2] : 0;
+    double p99 = count > 0 ? samples[(int) (count * 0.99)] : 0;
+    printf("{\"layout\":\"%s\",\"dist\":\"%s\",\"n\":%d,\"op\":\"%s\","
+           "\"ops_per_sec\":%.0f,\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"peak_rss_kb\":%ld}\n",
+           layout->name, dist, n, op, ops / secs, p50 * 1e9, p99 * 1e9, peak_rss_kb());
+    fflush(stdout);
+}
+
+//aplica op a cada clave; una de cada stride operaciones se mide por separado
+//para los percentiles de latencia
+typedef enum { OP_INSERT, OP_SEARCH, OP_UPPER, OP_ERASE } KeyOp;
+
+long apply(const Layout* l, void* map, KeyOp op, void* key){
+    switch(op){
+        case OP_INSERT: l->insert(map, key); return 1;
+        case OP_SEARCH: return l->search(map, key);
+        case OP_UPPER: return l->upper(map, key);
+        default: l->erase(map, key); return 1;
+    }
+}
+
+long measure_keys(const Layout* l, void* map, KeyOp op, void** keys, int n,
+                  double* secs, double* samples, int* count){
+    int stride = n > MAX_SAMPLES ? n / MAX_SAMPLES : 1;
+    long done = 0;
+    *count = 0;
+    double start = now();
+    for(int i=0; i<n; i++){
+        if(i % stride == 0 && *count < MAX_SAMPLES){
+            double t = now();
+            done += apply(l, map, op, keys[i]);
+            samples[(*count)++] = now() - t;
+        }else{
+            done += apply(l, map, op, keys[i]);
+        }
+    }
+    *secs = now() - start;
+    return done;
+}
+
+void run_config(const Layout* l, const char* dist, int n, const char* words_path){
+    Workload w;
+    make_workload(&w, dist, n, words_path);
+    n = w.n;
+    double* samples = (double*) malloc(sizeof(double) * MAX_SAMPLES);
+    double secs;
+    int count;
+    void* map = l->create(strcmp(dist, "string") == 0);
+
+    const char* names[] = {"insert", "search", "upper"};
+    void** keys[] = {w.inserts, w.probes, w.probes};
+    for(int op=OP_INSERT; op<=OP_UPPER; op++){
+        long done = measure_keys(l, map, op, keys[op], n, &secs, samples, &count);
+        if(done != n) fprintf(stderr, "%s/%s: %s resolvio %ld de %d\n", l->name, dist, names[op], done, n);
+        emit(l, dist, n, names[op], n, secs, samples, count);
+    }
+
+    if(l->batch != NULL){
+        long done = 0;
+        count = 0;
+        double start = now();
+        for(int i=0; i<n; i+=BATCH){
+            int size = n - i < BATCH ? n - i : BATCH;
+            double t = now();
+            done += l->batch(map, w.probes + i, size);
+            if(count < MAX_SAMPLES) samples[count++] = (now() - t) / size;
+        }
+        secs = now() - start;
+        if(done != n) fprintf(stderr, "%s/%s: batch resolvio %ld de %d\n", l->name, dist, done, n);
+        emit(l, dist, n, "batch", n, secs, samples, count);
+    }
+
+    int stride = n > MAX_SAMPLES ? n / MAX_SAMPLES : 1;
+    long steps = 0;
+    count = 0;
+    double start = now();
+    for(int ok = l->first(map); ok; steps++){
+        if(steps % stride == 0 && count < MAX_SAMPLES){
+            double t = now();
+            ok = l->next(map);
+            samples[count++] = now() - t;
+        }else{
+            ok = l->next(map);
+        }
+    }
+    secs = now() - start;
+    if(steps != n) fprintf(stderr, "%s/%s: iterate recorrio %ld de %d\n", l->name, dist, steps, n);
+    emit(l, dist, n, "iterate", steps, secs, samples, count);
+
+    if(l->snapshot){
+        //insert_hint: mismas inserciones en otro mapa, con la posicion de la
+        //anterior como pista (util en sorted y reverse)
+        void* hinted = l->create(strcmp(dist, "string") == 0);
+        TreeCursor hint = {0};
+        int stride = n > MAX_SAMPLES ? n / MAX_SAMPLES : 1;
+        count = 0;
+        double start = now();
+        for(int i=0; i<n; i++){
+            if(i % stride == 0 && count < MAX_SAMPLES){
+                double t = now();
+                insertHintTreeMap(hinted, &hint, w.inserts[i], w.inserts[i]);
+                samples[count++] = now() - t;
+            }else{
+                insertHintTreeMap(hinted, &hint, w.inserts[i], w.inserts[i]);
+            }
+        }
+        secs = now() - start;
+        emit(l, dist, n, "insert_hint", n, secs, samples, count);
+        l->destroy(hinted);
+
+        //open: abrir con mmap el archivo de saveTreeMap y hacer la primera
+        //busqueda, comparable con reconstruir el mapa (insert). Es una sola
+        //operacion: ops_per_sec son aperturas por segundo
+        int strings = strcmp(dist, "string") == 0;
+        char path[64];
+        sprintf(path, "bench_snapshot_%d.bin", (int) getpid());
+        size_t (*encode)(void*, void*, size_t) = strings ? encode_string : encode_int;
+        if(saveTreeMap(map, path, encode, encode)){
+            double t = now();
+            TreeMap* file = strings ? openTreeMapCompare(path, compare_string) : openTreeMap(path, lower_than_int);
+            tm_search(file, w.probes[0]);
+            secs = now() - t;
+            samples[0] = secs;
+            emit(l, dist, n, "open", 1, secs, samples, 1);
+
+            long done = measure_keys(l, file, OP_SEARCH, w.probes, n, &secs, samples, &count);
+            if(done != n) fprintf(stderr, "%s/%s: file_search resolvio %ld de %d\n", l->name, dist, done, n);
+            emit(l, dist, n, "file_search", n, secs, samples, count);
+            destroyTreeMap(file);
+        }
+        remove(path);
+    }
+
+    measure_keys(l, map, OP_ERASE, w.erases, n, &secs, samples, &count);
+    emit(l, dist, n, "erase", n, secs, samples, count);
+    l->destroy(map);
+}
+
+/* ---- escalamiento del mapa concurrente ---- */
+
+typedef struct{
+    ConcurrentTreeMap* concurrent;
+    TreeMap* locked;
+    pthread_mutex_t* lock;
+    int* probes;
+    int n;
+    int offset;
+}ReaderArgs;
+
+#define READS_PER_THREAD 1000000
+
+void* reader(void* arg){
+    ReaderArgs* r = (ReaderArgs*) arg;
+    Pair p;
+    long found = 0;
+    for(int i=0; i<READS_PER_THREAD; i++){
+        int* key = &r->probes[(r->offset + i) % r->n];
+        if(r->concurrent != NULL){
+            found += searchConcurrentTreeMap(r->concurrent, key, &p);
+        }else{
+            pthread_mutex_lock(r->lock);
+            found += searchTreeMap(r->locked, key) != NULL;
+            pthread_mutex_unlock(r->lock);
+        }
+    }
+    if(found != READS_PER_THREAD) fprintf(stderr, "lectores: %ld aciertos\n", found);
+    return NULL;
+}
+
+double run_readers(ConcurrentTreeMap* concurrent, TreeMap* locked, int* probes, int n, int threads){
+    pthread_t th[threads];
+    ReaderArgs args[threads];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    double t = now();
+    for(int i=0; i<threads; i++){
+        args[i].concurrent = concurrent;
+        args[i].locked = locked;
+        args[i].lock = &lock;
+        args[i].probes = probes;
+        args[i].n = n;
+        args[i].offset = i * (n / threads);
+        pthread_create(&th[i], NULL, reader, &args[i]);
+    }
+    for(int i=0; i<threads; i++) pthread_join(th[i], NULL);
+    return (double) threads * READS_PER_THREAD / (now() - t);
+}
+
+void run_concurrent(int n, int max_threads){
+    int* keys = (int*) malloc(sizeof(int) * n);
+    int* probes = (int*) malloc(sizeof(int) * n);
+    ConcurrentTreeMap* concurrent = createConcurrentTreeMap(lower_than_int);
+    TreeMap* locked = createTreeMap(lower_than_int);
+    for(int i=0; i<n; i++){
+        keys[i] = probes[i] = i;
+        insertConcurrentTreeMap(concurrent, &keys[i], &keys[i]);
+        insertTreeMap(locked, &keys[i], &keys[i]);
+    }
+    for(int i=n-1; i>0; i--){
+        int j = next_random() % (i+1);
+        int aux = probes[i]; probes[i] = probes[j]; probes[j] = aux;
+    }
+
+    double base = 0, base_locked = 0;
+    for(int threads=1; threads<=max_threads; threads*=2){
+        double ops = run_readers(concurrent, NULL, probes, n, threads);
+        double ops_locked = run_readers(NULL, locked, probes, n, threads);
+        if(threads == 1){
+            base = ops;
+            base_locked = ops_locked;
+        }
+        printf("{\"layout\":\"concurrent\",\"n\":%d,\"op\":\"search\",\"threads\":%d,"
+               "\"ops_per_sec\":%.0f,\"speedup\":%.2f,"
+               "\"mutex_ops_per_sec\":%.0f,\"mutex_speedup\":%.2f}\n",
+               n, threads, ops, ops / base, ops_locked, ops_locked / base_locked);
+        fflush(stdout);
+    }
+    destroyConcurrentTreeMap(concurrent);
+    destroyTreeMap(locked);
+    free(keys);
+    free(probes);
+}
+
+/* ---- recorrido y construccion en paralelo ---- */
+
+void sum_fold(void* acc, Pair* pair, void* data){
+    *((long long*) acc) += *((int*) pair->key);
+}
+
+void sum_combine(void* acc, void* other, void* data){
+    *((long long*) acc) += *((long long*) other);
+}
+
+void run_parallel(int n, int max_threads){
+    int* keys = (int*) malloc(sizeof(int) * n);
+    Pair* pairs = (Pair*) malloc(sizeof(Pair) * n);
+    for(int i=0; i<n; i++){
+        keys[i] = i;
+        pairs[i].key = pairs[i].value = &keys[i];
+    }
+    double base_reduce = 0, base_build = 0;
+    for(int threads=1; threads<=max_threads; threads*=2){
+        TreeMapPool* pool = createTreeMapPool(threads);
+        TreeMap* map = createTreeMap(lower_than_int);
+        double t = now();
+        buildParallelTreeMap(pool, map, pairs, n);
+        double build = n / (now() - t);
+
+        long long sum = 0;
+        t = now();
+        reduceTreeMap(pool, map, &sum, sizeof(sum), sum_fold, sum_combine, NULL);
+        double reduce = n / (now() - t);
+        if(sum != (long long) n * (n - 1) / 2) fprintf(stderr, "reduce: suma incorrecta\n");
+        if(threads == 1){
+            base_reduce = reduce;
+            base_build = build;
+        }
+        printf("{\"layout\":\"binary\",\"n\":%d,\"op\":\"parallel_reduce\",\"threads\":%d,"
+               "\"ops_per_sec\":%.0f,\"speedup\":%.2f}\n", n, threads, reduce, reduce / base_reduce);
+        printf("{\"layout\":\"binary\",\"n\":%d,\"op\":\"parallel_build\",\"threads\":%d,"
+               "\"ops_per_sec\":%.0f,\"speedup\":%.2f}\n", n, threads, build, build / base_build);
+        fflush(stdout);
+        destroyTreeMap(map);
+        destroyTreeMapPool(pool);
+    }
+    free(keys);
+    free(pairs);
+}
+
+/* ---- main ---- */
+
+int selected(const char* list, const char* name){
+    if(list == NULL) return 1;
+    size_t len = strlen(name);
+    for(const char* p = list; (p = strstr(p, name)) != NULL; p += len){
+        if((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0')) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    long min = 1000, max = 1000000;
+    int threads = 0;
+    const char* layout_list = NULL;
+    const char* dist_list = NULL;
+    const char* words_path = NULL;
+
+    for(int i=1; i<argc; i++){
+        const char* value = i + 1 < argc ? argv[i+1] : NULL;
+        if(value == NULL){
+            fprintf(stderr, "falta el valor de %s\n", argv[i]);
+            return 1;
+        }
+        if(strcmp(argv[i], "--min") == 0) min = atol(value);
+        else if(strcmp(argv[i], "--max") == 0) max = atol(value);
+        else if(strcmp(argv[i], "--layouts") == 0) layout_list = value;
+        else if(strcmp(argv[i], "--dists") == 0) dist_list = value;
+        else if(strcmp(argv[i], "--threads") == 0) threads = atoi(value);
+        else if(strcmp(argv[i], "--words") == 0) words_path = value;
+        else{
+            fprintf(stderr, "opcion desconocida: %s\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+
+    for(long n = min; n <= max; n *= 10){
+        for(int d=0; d<N_DISTS; d++){
+            if(!selected(dist_list, dists[d])) continue;
+            int strings = strcmp(dists[d], "string") == 0;
+            for(int l=0; l<N_LAYOUTS; l++){
+                if(!selected(layout_list, layouts[l].name)) continue;
+                if(strings ? !layouts[l].strings : !layouts[l].ints) continue;
+
+                pid_t pid = fork();
+                if(pid == 0){
+                    run_config(&layouts[l], dists[d], (int) n, words_path);
+                    exit(0);
+                }
+                int status;
+                waitpid(pid, &status, 0);
+                if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+                    fprintf(stderr, "%s/%s/%ld termino con error\n", layouts[l].name, dists[d], n);
+                }
+            }
+        }
+    }
+
+    if(threads > 0){
+        run_concurrent((int) max, threads);
+        run_parallel((int) max, threads);
+    }
+    return 0;
+}
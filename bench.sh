@@ -0,0 +1,6 @@
+#!/bin/bash
+# Compila y ejecuta la suite de benchmarks; los argumentos pasan a ./bench
+# Ejemplo: ./bench.sh --max 100000 --dists random,zipf > bench_output.txt
+set -e
+gcc -O2 -Wall -pthread bench.c treemap.c -o bench -lm
+./bench "$@"
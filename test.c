@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+//se compila sin y con -DTREEMAP_STATS (test.sh); los tests que leen las
+//estadisticas solo existen en la segunda version
 #include "treemap.c"
+#include "treemap_gen.h"
 
 char * _strdup(const char * str) {
     char * aux = (char *)malloc(strlen(str) + 1);
@@ -57,8 +60,7 @@ int lower_than_int(void* key1, void* key2){
 
 TreeMap* initializeTree(){
     info_msg("inicializando el arbol...");
-    TreeMap* tree=(TreeMap *)malloc(sizeof(TreeMap));
-    tree->lower_than = lower_than_int;
+    TreeMap* tree=createTreeMap(lower_than_int);
     Palabra* p=creaPalabra(5239,"auto");
     tree->root=createTreeNode(&p->id, p);
     p=creaPalabra(8213,"rayo");
@@ -499,10 +501,1756 @@ int ub_test4(TreeMap* tree){
     
 }
 
+//retorna la altura real del subarbol o -1 si no cumple AVL/padres
+int check_avl(TreeNode* n, TreeNode* parent){
+    if(n==NULL) return 0;
+    if(n->parent!=parent) return -1;
+    int hl=check_avl(n->left,n);
+    int hr=check_avl(n->right,n);
+    if(hl<0 || hr<0 || hl-hr>1 || hr-hl>1) return -1;
+    int h=1+(hl>hr?hl:hr);
+    if(n->height!=h) return -1;
+    int sz=1+(n->left?n->left->size:0)+(n->right?n->right->size:0);
+    if(n->size!=sz) return -1;
+    return h;
+}
+
+int* crea_claves(int n){
+    int* keys=(int*) malloc(sizeof(int)*n);
+    for(int i=0;i<n;i++) keys[i]=i;
+    return keys;
+}
+
+int balance_test1(){ //claves ordenadas
+    int n=1000;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    info_msg("insertando 1000 claves en orden ascendente");
+    for(int i=0;i<n;i++) insertTreeMap(t,&keys[i],&keys[i]);
+
+    int h=check_avl(t->root,NULL);
+    if(h<0 || h>15){
+        sprintf(msg,"el arbol no esta balanceado (altura %d)",h);
+        err_msg(msg);
+        return 0;
+    }
+    sprintf(msg,"arbol balanceado con altura %d",h);
+    ok_msg(msg);
+
+    int i=0;
+    Pair* aux=firstTreeMap(t);
+    while(aux!=NULL && *((int*)aux->key)==i){
+        i++;
+        aux=nextTreeMap(t);
+    }
+    if(i!=n){
+        err_msg("el recorrido en orden no retorna todas las claves");
+        return 0;
+    }
+    ok_msg("recorrido en orden correcto");
+    return 1;
+}
+
+int balance_test2(){ //eliminaciones
+    int n=1000;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    for(int i=n-1;i>=0;i--) insertTreeMap(t,&keys[i],&keys[i]);
+    info_msg("eliminando las claves pares");
+    for(int i=0;i<n;i+=2) eraseTreeMap(t,&keys[i]);
+
+    if(check_avl(t->root,NULL)<0){
+        err_msg("el arbol no esta balanceado despues de eliminar");
+        return 0;
+    }
+    for(int i=0;i<n;i++){
+        Pair* p=searchTreeMap(t,&keys[i]);
+        if((i%2==0 && p!=NULL) || (i%2==1 && p==NULL)){
+            sprintf(msg,"search(%d) retorna un resultado incorrecto",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("arbol balanceado despues de eliminar");
+    return 1;
+}
+
+int balance_test3(){ //forma del arbol de initializeTree armado con insertTreeMap
+    int ids[]={5239,1273,8213,6980};
+    TreeMap* t=createTreeMap(lower_than_int);
+    for(int i=0;i<4;i++) insertTreeMap(t,&ids[i],&ids[i]);
+    if(check_avl(t->root,NULL)<0 || *((int*)t->root->pair->key)!=5239 ||
+           *((int*)t->root->right->left->pair->key)!=6980){
+        err_msg("insertTreeMap no arma el arbol 5239 -> (1273, 8213 -> (6980, -))");
+        return 0;
+    }
+    info_msg("eliminando la hoja 1273");
+    eraseTreeMap(t,&ids[1]);
+    if(check_avl(t->root,NULL)<0 || *((int*)t->root->pair->key)!=6980 ||
+           *((int*)t->root->left->pair->key)!=5239 || *((int*)t->root->right->pair->key)!=8213){
+        err_msg("al eliminar 1273 la raiz debe rotar y quedar 6980 -> (5239, 8213)");
+        return 0;
+    }
+    ok_msg("la raiz rota al eliminar una hoja del lado corto");
+    destroyTreeMap(t);
+    return 1;
+}
+
+int pool_test(){
+    int n=500;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    for(int i=0;i<n;i++) insertTreeMap(t,&keys[i],&keys[i]);
+
+    Pair* p=searchTreeMap(t,&keys[7]);
+    if(p==NULL || p!=&t->current->entry){
+        err_msg("el Pair no se guarda dentro del nodo");
+        return 0;
+    }
+    ok_msg("Pair guardado dentro del nodo");
+
+    NodeSlab* slabs=t->pool.slabs;
+    info_msg("eliminando y reinsertando todas las claves");
+    for(int i=0;i<n;i++) eraseTreeMap(t,&keys[i]);
+    for(int i=0;i<n;i++) insertTreeMap(t,&keys[i],&keys[i]);
+    if(t->pool.slabs!=slabs){
+        err_msg("se reservaron bloques nuevos en vez de reutilizar nodos");
+        return 0;
+    }
+    ok_msg("los nodos eliminados se reutilizan");
+    destroyTreeMap(t);
+    free(keys);
+    return 1;
+}
+
+int bounds_test(){
+    int n=100;
+    int* keys=(int*) malloc(sizeof(int)*n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    for(int i=0;i<n;i++){ //claves pares 0..198
+        keys[i]=2*i;
+        insertTreeMap(t,&keys[i],&keys[i]);
+    }
+
+    int k=10;
+    Pair* p=upperBound(t,&k);
+    if(p==NULL || p!=searchTreeMap(t,&k)){
+        err_msg("upperBound no retorna el Pair guardado en el arbol");
+        return 0;
+    }
+    ok_msg("upperBound retorna el Pair del arbol");
+
+    int q[4]={11,11,10,10};
+    int expected[4][5]={ //upper, ceiling, floor, higher, lower
+        {12,12,10,12,10},{12,12,10,12,10},{10,10,10,12,8},{10,10,10,12,8}};
+    for(int i=0;i<4;i++){
+        Pair* r[5]={upperBound(t,&q[i]),ceilingTreeMap(t,&q[i]),floorTreeMap(t,&q[i]),
+                    higherTreeMap(t,&q[i]),lowerTreeMap(t,&q[i])};
+        for(int j=0;j<5;j++){
+            if(r[j]==NULL || *((int*)r[j]->key)!=expected[i][j]){
+                sprintf(msg,"cota %d de %d incorrecta",j,q[i]);
+                err_msg(msg);
+                return 0;
+            }
+        }
+    }
+    ok_msg("ceiling/floor/higher/lower correctos");
+
+    int lo=-1, hi=198;
+    if(floorTreeMap(t,&lo)!=NULL || lowerTreeMap(t,&keys[0])!=NULL ||
+       higherTreeMap(t,&hi)!=NULL){
+        err_msg("las cotas fuera de rango deben retornar NULL");
+        return 0;
+    }
+    ok_msg("cotas fuera de rango retornan NULL");
+    destroyTreeMap(t);
+    free(keys);
+    return 1;
+}
+
+long cmp_calls=0;
+
+int compare_int(void* key1, void* key2){
+    cmp_calls++;
+    int k1 = *((int*) (key1));
+    int k2 = *((int*) (key2));
+    return (k1>k2)-(k1<k2);
+}
+
+int lower_than_int_count(void* key1, void* key2){
+    cmp_calls++;
+    return lower_than_int(key1,key2);
+}
+
+int compare_mode_test(){
+    int n=1023;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMapCompare(compare_int);
+    TreeMap* u=createTreeMap(lower_than_int_count);
+    for(int i=0;i<n;i++){
+        insertTreeMap(t,&keys[i],&keys[i]);
+        insertTreeMap(u,&keys[i],&keys[i]);
+    }
+    int h=t->root->height;
+
+    cmp_calls=0;
+    for(int i=0;i<n;i++){
+        if(searchTreeMap(t,&keys[i])==NULL || *((int*)t->current->pair->key)!=i){
+            err_msg("search con compare no encuentra la clave");
+            return 0;
+        }
+    }
+    if(cmp_calls>(long)n*h){
+        sprintf(msg,"search con compare usa %ld llamadas (maximo %ld)",cmp_calls,(long)n*h);
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("search con compare usa a lo mas una llamada por nivel");
+
+    cmp_calls=0;
+    for(int i=0;i<n;i++) searchTreeMap(u,&keys[i]);
+    if(cmp_calls>(long)n*(u->root->height+1)){
+        sprintf(msg,"search con lower_than usa %ld llamadas",cmp_calls);
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("search con lower_than usa una llamada por nivel");
+
+    int k=n;
+    insertTreeMap(t,&keys[5],&k);
+    if(searchTreeMap(t,&keys[5])->value!=&keys[5] || upperBound(t,&k)!=NULL){
+        err_msg("insert con compare no respeta claves repetidas");
+        return 0;
+    }
+    eraseTreeMap(t,&keys[5]);
+    if(searchTreeMap(t,&keys[5])!=NULL){
+        err_msg("erase con compare no elimina la clave");
+        return 0;
+    }
+    ok_msg("insert/erase con compare correctos");
+    destroyTreeMap(t);
+    destroyTreeMap(u);
+    free(keys);
+    return 1;
+}
+
+int btree_test(){
+    int n=4000;
+    int* keys=crea_claves(n);
+    char* present=(char*) calloc(n,1);
+    TreeMap* t=createBTreeMap(lower_than_int);
+    srand(7);
+    info_msg("20000 inserciones/eliminaciones aleatorias en el B+tree");
+    for(int op=0;op<20000;op++){
+        int k=rand()%n;
+        if(rand()%3){
+            insertTreeMap(t,&keys[k],&keys[k]);
+            present[k]=1;
+        }else{
+            eraseTreeMap(t,&keys[k]);
+            present[k]=0;
+        }
+    }
+
+    for(int i=0;i<n;i++){
+        Pair* p=searchTreeMap(t,&keys[i]);
+        if((p!=NULL)!=present[i] || (p!=NULL && p->value!=&keys[i])){
+            sprintf(msg,"search(%d) no coincide con lo insertado",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("search coincide con lo insertado");
+
+    int expected=0;
+    Pair* aux=firstTreeMap(t);
+    while(aux!=NULL){
+        while(expected<n && !present[expected]) expected++;
+        if(*((int*)aux->key)!=expected){
+            err_msg("first/next no recorren las claves en orden");
+            return 0;
+        }
+        expected++;
+        aux=nextTreeMap(t);
+    }
+    while(expected<n && !present[expected]) expected++;
+    if(expected!=n){
+        err_msg("first/next no recorren todas las claves");
+        return 0;
+    }
+    ok_msg("first/next recorren las claves en orden");
+
+    for(int i=0;i<n;i++){
+        int ub=i, lb=i;
+        while(ub<n && !present[ub]) ub++;
+        while(lb>=0 && !present[lb]) lb--;
+        Pair* u=upperBound(t,&keys[i]);
+        Pair* l=floorTreeMap(t,&keys[i]);
+        if((ub==n ? u!=NULL : (u==NULL || *((int*)u->key)!=ub)) ||
+           (lb<0 ? l!=NULL : (l==NULL || *((int*)l->key)!=lb))){
+            sprintf(msg,"cotas de %d incorrectas",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("upperBound/floorTreeMap correctos");
+
+    for(int i=0;i<n;i++) eraseTreeMap(t,&keys[i]);
+    if(firstTreeMap(t)!=NULL){
+        err_msg("el mapa no queda vacio");
+        return 0;
+    }
+    ok_msg("el mapa queda vacio al eliminar todo");
+    destroyTreeMap(t);
+    free(present);
+    free(keys);
+    return 1;
+}
+
+int cursor_check(TreeMap* t, int n, int* keys){
+    for(int i=0;i<n;i++) insertTreeMap(t,&keys[i],&keys[i]);
+
+    firstTreeMap(t);
+    nextTreeMap(t);
+    if(lookupTreeMap(t,&keys[n/2])==NULL || lookupTreeMap(t,&n)!=NULL){
+        err_msg("lookupTreeMap retorna un resultado incorrecto");
+        return 0;
+    }
+    Pair* aux=nextTreeMap(t);
+    if(aux==NULL || *((int*)aux->key)!=2){
+        err_msg("lookupTreeMap interrumpe la iteracion con current");
+        return 0;
+    }
+    ok_msg("lookupTreeMap no modifica current");
+
+    TreeCursor a, b;
+    int k=n/3, i=k;
+    Pair* p=seekCursor(&a,t,&k);
+    lastCursor(&b,t);
+    while(p!=NULL && *((int*)p->key)==i){
+        searchTreeMap(t,&keys[0]);
+        prevCursor(&b);
+        i++;
+        p=nextCursor(&a);
+    }
+    if(i!=n || cursorPair(&b)==NULL || *((int*)cursorPair(&b)->key)!=k-1){
+        err_msg("los cursores no recorren el mapa en orden");
+        return 0;
+    }
+    ok_msg("dos cursores recorren el mapa en ambos sentidos");
+
+    for(i=k-1,p=cursorPair(&b); p!=NULL; p=prevCursor(&b)) i--;
+    if(i!=-1 || firstCursor(&a,t)==NULL || prevCursor(&a)!=NULL){
+        err_msg("prevCursor no llega al inicio");
+        return 0;
+    }
+    ok_msg("prevCursor llega al inicio");
+    destroyTreeMap(t);
+    return 1;
+}
+
+int cursor_test(){
+    int n=300;
+    int* keys=crea_claves(n);
+    info_msg("cursores sobre el arbol binario");
+    int ok=cursor_check(createTreeMap(lower_than_int),n,keys);
+    info_msg("cursores sobre el B+tree");
+    ok=ok && cursor_check(createBTreeMap(lower_than_int),n,keys);
+    free(keys);
+    return ok;
+}
+
+typedef struct{
+    ConcurrentTreeMap* map;
+    int* keys;
+    int n;
+    long misses;
+}ReaderArgs;
+
+void* concurrent_reader(void* arg){
+    ReaderArgs* r=(ReaderArgs*) arg;
+    Pair p;
+    for(int round=0;round<20;round++)
+        for(int i=0;i<r->n;i++)
+            if(!searchConcurrentTreeMap(r->map,&r->keys[i],&p) || p.value!=&r->keys[i])
+                r->misses++;
+    return NULL;
+}
+
+int concurrent_test(){
+    int n=2000;
+    int* keys=crea_claves(2*n);
+    ConcurrentTreeMap* m=createConcurrentTreeMap(lower_than_int);
+    for(int i=0;i<n;i++) insertConcurrentTreeMap(m,&keys[i],&keys[i]);
+
+    info_msg("3 lectores buscan mientras un escritor inserta y elimina");
+    pthread_t th[3];
+    ReaderArgs args[3];
+    for(int i=0;i<3;i++){
+        args[i].map=m; args[i].keys=keys; args[i].n=n; args[i].misses=0;
+        pthread_create(&th[i],NULL,concurrent_reader,&args[i]);
+    }
+    for(int i=n;i<2*n;i++) insertConcurrentTreeMap(m,&keys[i],&keys[i]);
+    for(int i=n;i<2*n;i+=2) eraseConcurrentTreeMap(m,&keys[i]);
+    long misses=0;
+    for(int i=0;i<3;i++){
+        pthread_join(th[i],NULL);
+        misses+=args[i].misses;
+    }
+    if(misses!=0){
+        sprintf(msg,"los lectores no encontraron %ld claves",misses);
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("los lectores siempre encuentran las claves existentes");
+
+    Pair p;
+    int k=n;
+    if(searchConcurrentTreeMap(m,&keys[n],&p) ||
+       !upperBoundConcurrentTreeMap(m,&k,&p) || p.key!=&keys[n+1]){
+        err_msg("search/upperBound concurrentes incorrectos tras eliminar");
+        return 0;
+    }
+    ok_msg("search/upperBound concurrentes correctos");
+    destroyConcurrentTreeMap(m);
+    free(keys);
+    return 1;
+}
+
+int build_test(){
+    int n=1000;
+    int* keys=crea_claves(n);
+    Pair* pairs=(Pair*) malloc(sizeof(Pair)*n);
+    for(int i=0;i<n;i++){
+        pairs[i].key=&keys[i];
+        pairs[i].value=&keys[i];
+    }
+    TreeMap* t=createTreeMap(lower_than_int);
+    info_msg("construyendo un arbol con 1000 pares ordenados");
+    buildTreeMap(t,pairs,n);
+
+    int h=check_avl(t->root,NULL);
+    if(h!=10){
+        sprintf(msg,"el arbol construido no es perfectamente balanceado (altura %d)",h);
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("arbol perfectamente balanceado y con padres correctos");
+
+    int i=0;
+    for(Pair* p=firstTreeMap(t);p!=NULL && *((int*)p->key)==i;p=nextTreeMap(t)) i++;
+    if(i!=n){
+        err_msg("nextTreeMap no recorre el arbol construido");
+        return 0;
+    }
+    ok_msg("nextTreeMap recorre el arbol construido");
+
+    int k=n;
+    insertTreeMap(t,&k,&k);
+    eraseTreeMap(t,&keys[0]);
+    if(searchTreeMap(t,&k)==NULL || searchTreeMap(t,&keys[0])!=NULL || check_avl(t->root,NULL)<0){
+        err_msg("insert/erase fallan sobre el arbol construido");
+        return 0;
+    }
+    ok_msg("insert/erase funcionan sobre el arbol construido");
+    destroyTreeMap(t);
+    free(pairs);
+    free(keys);
+    return 1;
+}
+
+typedef struct{
+    int next;
+    int limit;
+}RangeState;
+
+//verifica el orden y se detiene al llegar a limit
+int range_visit(Pair* p, void* data){
+    RangeState* st=(RangeState*) data;
+    if(*((int*)p->key)!=st->next) st->next=-1000000;
+    st->next+=2;
+    return st->next<st->limit;
+}
+
+int range_check(TreeMap* t){
+    int lo=11, hi=101;
+    RangeState st={12,1000000};
+    long visited=rangeTreeMap(t,&lo,&hi,range_visit,&st);
+    if(visited!=45 || st.next!=102){
+        sprintf(msg,"rango [11,101) visita %ld pares",visited);
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("rango [11,101) visita las claves en orden");
+
+    st.next=0; st.limit=20;
+    visited=rangeTreeMap(t,NULL,&hi,range_visit,&st);
+    if(visited!=10 || st.next!=20){
+        err_msg("el recorrido no se detiene cuando visit retorna 0");
+        return 0;
+    }
+    ok_msg("el recorrido se detiene cuando visit retorna 0");
+
+    if(countRangeTreeMap(t,&lo,NULL)!=494 || countRangeTreeMap(t,&hi,&lo)!=0 ||
+       countRangeTreeMap(t,NULL,NULL)!=500){
+        err_msg("countRangeTreeMap incorrecto");
+        return 0;
+    }
+    ok_msg("countRangeTreeMap correcto");
+    destroyTreeMap(t);
+    return 1;
+}
+
+int range_test(){
+    int n=500;
+    int* keys=(int*) malloc(sizeof(int)*n);
+    TreeMap* a=createTreeMap(lower_than_int);
+    TreeMap* b=createBTreeMap(lower_than_int);
+    for(int i=0;i<n;i++){ //claves pares 0..998
+        keys[i]=2*i;
+        insertTreeMap(a,&keys[i],&keys[i]);
+        insertTreeMap(b,&keys[i],&keys[i]);
+    }
+    info_msg("rangos sobre el arbol binario");
+    int ok=range_check(a);
+    info_msg("rangos sobre el B+tree");
+    ok=ok && range_check(b);
+    free(keys);
+    return ok;
+}
+
+int batch_test(){
+    int n=1000, m=300;
+    int* keys=crea_claves(2*n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    for(int i=0;i<n;i++) insertTreeMap(t,&keys[2*i],&keys[2*i]);
+
+    void* probes[300];
+    Pair* out[300];
+    for(int i=0;i<m;i++) probes[i]=&keys[(i*37)%(2*n)];
+    firstTreeMap(t);
+    TreeNode* current=t->current;
+    int hits=searchBatchTreeMap(t,probes,m,out);
+
+    int expected=0;
+    for(int i=0;i<m;i++){
+        int k=*((int*)probes[i]);
+        if(k%2==0) expected++;
+        if((k%2==0 && (out[i]==NULL || out[i]->value!=probes[i])) ||
+           (k%2==1 && out[i]!=NULL)){
+            sprintf(msg,"resultado del lote incorrecto para la clave %d",k);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    if(hits!=expected || t->current!=current){
+        err_msg("searchBatchTreeMap retorna mal los aciertos o modifica current");
+        return 0;
+    }
+    ok_msg("searchBatchTreeMap reporta aciertos y fallos por clave");
+    destroyTreeMap(t);
+    free(keys);
+    return 1;
+}
+
+int order_test(){
+    int n=1000;
+    int* keys=crea_claves(2*n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    srand(11);
+    for(int i=0;i<3*n;i++){ //se insertan las claves pares en orden aleatorio
+        int k=2*(rand()%n);
+        insertTreeMap(t,&keys[k],&keys[k]);
+    }
+    for(int i=0;i<2*n;i+=2) insertTreeMap(t,&keys[i],&keys[i]);
+    info_msg("eliminando las claves multiplo de 4");
+    for(int i=0;i<2*n;i+=4) eraseTreeMap(t,&keys[i]);
+
+    if(check_avl(t->root,NULL)<0 || sizeTreeMap(t)!=n/2){
+        err_msg("los tamanos de los subarboles no se mantienen");
+        return 0;
+    }
+    ok_msg("tamanos de subarboles correctos");
+
+    for(int k=0;k<n/2;k++){
+        int key=4*k+2;
+        Pair* p=selectTreeMap(t,k);
+        if(p==NULL || *((int*)p->key)!=key || rankTreeMap(t,&keys[key])!=k ||
+           rankTreeMap(t,&keys[key+1])!=k+1){
+            sprintf(msg,"select/rank incorrectos para k=%d",k);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    if(selectTreeMap(t,n/2)!=NULL || selectTreeMap(t,-1)!=NULL){
+        err_msg("select fuera de rango debe retornar NULL");
+        return 0;
+    }
+    ok_msg("rankTreeMap y selectTreeMap correctos");
+
+    int lo=10, hi=30;
+    Pair* p=selectTreeMap(t,3);
+    p=nextTreeMap(t);
+    if(p==NULL || *((int*)p->key)!=18 || countRangeTreeMap(t,&keys[lo],&keys[hi])!=5){
+        err_msg("nextTreeMap despues de select o countRangeTreeMap incorrectos");
+        return 0;
+    }
+    ok_msg("nextTreeMap continua desde select");
+    destroyTreeMap(t);
+    free(keys);
+
+    n=20000; //varios niveles de nodos internos en el B+tree
+    keys=crea_claves(2*n);
+    t=createBTreeMap(lower_than_int);
+    for(int i=0;i<3*n;i++){
+        int k=2*(rand()%n);
+        insertTreeMap(t,&keys[k],&keys[k]);
+    }
+    for(int i=0;i<2*n;i+=2) insertTreeMap(t,&keys[i],&keys[i]);
+    for(int i=0;i<2*n;i+=4) eraseTreeMap(t,&keys[i]);
+    for(int k=0;k<n/2;k++){
+        int key=4*k+2;
+        Pair* p=selectTreeMap(t,k);
+        if(p==NULL || *((int*)p->key)!=key || rankTreeMap(t,&keys[key])!=k ||
+           rankTreeMap(t,&keys[key+1])!=k+1 ||
+           countRangeTreeMap(t,&keys[key],&keys[2*n-1])!=n/2-k){
+            sprintf(msg,"select/rank del B+tree incorrectos para k=%d",k);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("rankTreeMap y selectTreeMap correctos en B+tree");
+    destroyTreeMap(t);
+    free(keys);
+    return 1;
+}
+
+int int_map_test(){
+    int n=4000;
+    int* keys=crea_claves(n);
+    char* present=(char*) calloc(n,1);
+    IntTreeMap* m=createIntTreeMap();
+    srand(5);
+    info_msg("20000 inserciones/eliminaciones aleatorias con claves int64");
+    for(int op=0;op<20000;op++){
+        int k=rand()%n;
+        if(rand()%3){
+            insertIntTreeMap(m,k,&keys[k]);
+            present[k]=1;
+        }else{
+            eraseIntTreeMap(m,k);
+            present[k]=0;
+        }
+    }
+
+    long count=0;
+    for(int i=0;i<n;i++){
+        count+=present[i];
+        void* v=searchIntTreeMap(m,i);
+        if((v!=NULL)!=present[i] || (v!=NULL && v!=&keys[i])){
+            sprintf(msg,"searchIntTreeMap(%d) no coincide con lo insertado",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    if(sizeIntTreeMap(m)!=count){
+        err_msg("sizeIntTreeMap incorrecto");
+        return 0;
+    }
+    ok_msg("searchIntTreeMap coincide con lo insertado");
+
+    IntPair p;
+    int expected=0, ok=firstIntTreeMap(m,&p);
+    while(ok){
+        while(!present[expected]) expected++;
+        if(p.key!=expected) break;
+        expected++;
+        ok=nextIntTreeMap(m,&p);
+    }
+    while(expected<n && !present[expected]) expected++;
+    if(ok || expected!=n){
+        err_msg("first/next no recorren las claves en orden");
+        return 0;
+    }
+    ok_msg("first/next recorren las claves en orden");
+
+    for(int i=0;i<n;i++){
+        int ub=i+1, lb=i-1;
+        while(ub<n && !present[ub]) ub++;
+        while(lb>=0 && !present[lb]) lb--;
+        IntPair u, l;
+        int hu=higherIntTreeMap(m,i,&u), hl=lowerIntTreeMap(m,i,&l);
+        if((ub==n ? hu : (!hu || u.key!=ub)) || (lb<0 ? hl : (!hl || l.key!=lb)) ||
+           upperBoundIntTreeMap(m,i,&u)!=(present[i] || ub<n) ||
+           ceilingIntTreeMap(m,i,&u)!=(present[i] || ub<n) ||
+           floorIntTreeMap(m,i,&l)!=(present[i] || lb>=0)){
+            sprintf(msg,"cotas de %d incorrectas",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("cotas correctas");
+    destroyIntTreeMap(m);
+    free(present);
+    free(keys);
+    return 1;
+}
+
+int compare_string(void* key1, void* key2){
+    return strcmp((char*) key1,(char*) key2);
+}
+
+int string_map_test(){
+    int n=2000;
+    char** words=(char**) malloc(sizeof(char*)*n);
+    char* prefixes[4]={"","cas","internacional","internacionalizacion"};
+    srand(9);
+    for(int i=0;i<n;i++){ //palabras con prefijos comunes cortos y largos
+        char buf[64];
+        int len=sprintf(buf,"%s",prefixes[rand()%4]);
+        int extra=rand()%6;
+        for(int j=0;j<extra;j++) buf[len++]='a'+rand()%3;
+        buf[len]='\0';
+        words[i]=_strdup(buf);
+    }
+
+    TreeMap* t=createStringTreeMap();
+    TreeMap* ref=createTreeMapCompare(compare_string);
+    for(int i=0;i<n;i++){
+        insertTreeMap(t,words[i],words[i]);
+        insertTreeMap(ref,words[i],words[i]);
+    }
+    for(int i=0;i<n;i+=3){
+        eraseTreeMap(t,words[i]);
+        eraseTreeMap(ref,words[i]);
+    }
+    //al enhebrar los nodos se copian y el prefijo pasa despues de los enlaces
+    threadTreeMap(t);
+    for(int i=0;i<n;i+=6){
+        insertTreeMap(t,words[i],words[i]);
+        insertTreeMap(ref,words[i],words[i]);
+    }
+
+    Pair* a=firstTreeMap(t);
+    Pair* b=firstTreeMap(ref);
+    while(a!=NULL && b!=NULL && strcmp(a->key,b->key)==0){
+        a=nextTreeMap(t);
+        b=nextTreeMap(ref);
+    }
+    if(a!=NULL || b!=NULL){
+        err_msg("el mapa de strings no ordena como strcmp");
+        return 0;
+    }
+    ok_msg("el mapa de strings ordena como strcmp");
+
+    char probe[64];
+    for(int i=0;i<n;i++){
+        sprintf(probe,"%sb",words[i]);
+        Pair* x=searchTreeMap(t,words[i]);
+        Pair* y=searchTreeMap(ref,words[i]);
+        Pair* u=upperBound(t,probe);
+        Pair* v=upperBound(ref,probe);
+        Pair* l=floorTreeMap(t,words[i]);
+        Pair* m=floorTreeMap(ref,words[i]);
+        if((x==NULL)!=(y==NULL) || (u==NULL)!=(v==NULL) || (u!=NULL && strcmp(u->key,v->key)!=0) ||
+           (l==NULL)!=(m==NULL) || (l!=NULL && strcmp(l->key,m->key)!=0)){
+            sprintf(msg,"busqueda/cotas de \"%s\" no coinciden con strcmp",words[i]);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("search y cotas coinciden con strcmp");
+    destroyTreeMap(t);
+    destroyTreeMap(ref);
+    for(int i=0;i<n;i++) free(words[i]);
+    free(words);
+    return 1;
+}
+
+#define int_lt(a, b) ((a) < (b))
+TREEMAP_INIT(gmap, int, int*, int_lt)
+
+int check_gen(gmap_node_t* x, gmap_node_t* parent){
+    if(x==NULL) return 0;
+    if(x->parent!=parent) return -1;
+    int hl=check_gen(x->left,x), hr=check_gen(x->right,x);
+    if(hl<0 || hr<0 || hl-hr>1 || hr-hl>1 || x->height!=1+(hl>hr?hl:hr)) return -1;
+    return x->height;
+}
+
+int generic_test(){
+    int n=3000;
+    int* keys=crea_claves(n);
+    char* present=(char*) calloc(n,1);
+    gmap_t* m=gmap_create();
+    srand(13);
+    info_msg("mapa generado con TREEMAP_INIT(gmap, int, int*, int_lt)");
+    for(int op=0;op<15000;op++){
+        int k=rand()%n;
+        if(rand()%3){
+            if(gmap_put(m,k,&keys[k])==present[k]){
+                err_msg("gmap_put retorna un valor incorrecto");
+                return 0;
+            }
+            present[k]=1;
+        }else{
+            if(gmap_del(m,k)!=present[k]){
+                err_msg("gmap_del retorna un valor incorrecto");
+                return 0;
+            }
+            present[k]=0;
+        }
+    }
+    if(check_gen(m->root,NULL)<0){
+        err_msg("el mapa generado no esta balanceado");
+        return 0;
+    }
+    ok_msg("el mapa generado se mantiene balanceado");
+
+    long count=0;
+    for(int i=0;i<n;i++){
+        count+=present[i];
+        gmap_node_t* x=gmap_get(m,i);
+        gmap_node_t* u=gmap_upper_bound(m,i);
+        int ub=i;
+        while(ub<n && !present[ub]) ub++;
+        if((x!=NULL)!=present[i] || (x!=NULL && x->value!=&keys[i]) ||
+           (ub==n ? u!=NULL : (u==NULL || u->key!=ub))){
+            sprintf(msg,"gmap_get/gmap_upper_bound(%d) incorrectos",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    long seen=0;
+    int last=-1;
+    for(gmap_node_t* x=gmap_first(m);x!=NULL;x=gmap_next(x)){
+        if(x->key<=last) break;
+        last=x->key;
+        seen++;
+    }
+    if(seen!=count || gmap_size(m)!=count){
+        err_msg("gmap_first/gmap_next no recorren el mapa en orden");
+        return 0;
+    }
+    ok_msg("get, upper_bound e iteracion correctos");
+    gmap_destroy(m);
+    free(present);
+    free(keys);
+    return 1;
+}
+
+#ifdef TREEMAP_STATS
+int check_stats(TreeMap* t, long n){
+    TreeMapStats st;
+    statsTreeMap(t,&st);
+    long total=0;
+    double sum=0;
+    int deepest=0;
+    for(int d=0;d<TREEMAP_STATS_DEPTHS;d++){
+        total+=st.depthHistogram[d];
+        sum+=(double) (d+1)*st.depthHistogram[d];
+        if(st.depthHistogram[d]>0) deepest=d+1;
+    }
+    if(st.entries!=n || total!=n || deepest!=st.maxDepth ||
+       (n>0 && (sum/n<st.avgDepth-1e-9 || sum/n>st.avgDepth+1e-9))){
+        err_msg("el histograma de profundidades no coincide con entries/maxDepth/avgDepth");
+        return 0;
+    }
+    if(st.pairBytes!=n*sizeof(Pair) || st.nodeBytes<st.pairBytes){
+        err_msg("nodeBytes/pairBytes incorrectos");
+        return 0;
+    }
+    return 1;
+}
+
+int stats_test(){
+    int n=1023;
+    int* keys=crea_claves(n);
+    TreeMap* maps[2]={createTreeMap(lower_than_int),createBTreeMap(lower_than_int)};
+    for(int m=0;m<2;m++){
+        TreeMap* t=maps[m];
+        for(int i=0;i<n;i++) insertTreeMap(t,&keys[i],&keys[i]);
+        TreeMapStats st;
+        statsTreeMap(t,&st);
+        if(m==0 && (st.allocs!=n || st.frees!=0 || st.maxDepth!=10 || st.depthHistogram[9]!=512)){
+            sprintf(msg,"arbol con %d claves ordenadas: allocs=%llu frees=%llu maxDepth=%d",n,st.allocs,st.frees,st.maxDepth);
+            err_msg(msg);
+            return 0;
+        }
+        if(m==1 && st.depthHistogram[st.maxDepth-1]!=n){
+            err_msg("en el B+tree todos los pares deben estar a la misma profundidad");
+            return 0;
+        }
+        if(!check_stats(t,n)) return 0;
+
+        resetStatsTreeMap(t);
+        searchTreeMap(t,&keys[n/3]);
+        statsTreeMap(t,&st);
+        if(st.comparisons==0 || (m==0 && st.comparisons>st.maxDepth+1)){
+            sprintf(msg,"una busqueda conto %llu comparaciones (maxDepth=%d)",st.comparisons,st.maxDepth);
+            err_msg(msg);
+            return 0;
+        }
+        for(int i=0;i<n;i+=3) eraseTreeMap(t,&keys[i]);
+        statsTreeMap(t,&st);
+        if(st.frees==0 || (m==0 && st.frees!=(n+2)/3)){
+            sprintf(msg,"eliminar %d claves conto %llu liberaciones",(n+2)/3,st.frees);
+            err_msg(msg);
+            return 0;
+        }
+        if(!check_stats(t,n-(n+2)/3)) return 0;
+        destroyTreeMap(t);
+    }
+    ok_msg("comparaciones, reservas, profundidades y memoria correctas");
+    free(keys);
+    return 1;
+}
+#endif
+
+size_t encode_int(void* key, void* buf, size_t cap){
+    if(cap>=sizeof(int)) memcpy(buf,key,sizeof(int));
+    return sizeof(int);
+}
+
+size_t encode_word(void* value, void* buf, size_t cap){
+    size_t len=strlen((char*) value)+1;
+    if(cap>=len) memcpy(buf,value,len);
+    return len;
+}
+
+int snapshot_test(){
+    int n=5000;
+    int* keys=crea_claves(n);
+    char** words=(char**) malloc(sizeof(char*)*n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    srand(17);
+    for(int i=0;i<n;i++){
+        words[i]=(char*) malloc(64);
+        sprintf(words[i],"palabra numero %d con texto largo %d",i,i*7);
+    }
+    for(int i=0;i<n;i++){
+        int k=2*((rand()%n)/2); //solo claves pares
+        insertTreeMap(t,&keys[k],words[k]);
+    }
+    const char* path="test_snapshot.bin";
+    if(!saveTreeMap(t,path,encode_int,encode_word)){
+        err_msg("saveTreeMap no pudo guardar el archivo");
+        return 0;
+    }
+    TreeMap* f=openTreeMap(path,lower_than_int);
+    if(f==NULL || sizeTreeMap(f)!=sizeTreeMap(t)){
+        err_msg("openTreeMap no abre el archivo o cambia la cantidad de pares");
+        return 0;
+    }
+    ok_msg("saveTreeMap/openTreeMap");
+
+    for(int i=-1;i<=n;i++){
+        Pair* a=searchTreeMap(t,&i);
+        Pair* b=searchTreeMap(f,&i);
+        Pair* u=upperBound(t,&i);
+        Pair* v=upperBound(f,&i);
+        Pair* l=floorTreeMap(t,&i);
+        Pair* m=floorTreeMap(f,&i);
+        if((a==NULL)!=(b==NULL) || (a!=NULL && (*(int*)b->key!=i || strcmp(a->value,b->value)!=0)) ||
+           (u==NULL)!=(v==NULL) || (u!=NULL && *(int*)u->key!=*(int*)v->key) ||
+           (l==NULL)!=(m==NULL) || (l!=NULL && *(int*)l->key!=*(int*)m->key) ||
+           (b!=NULL && searchTreeMap(f,&i)!=b)){
+            sprintf(msg,"search/upperBound/floorTreeMap(%d) no coinciden con el mapa original",i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    ok_msg("search y cotas en el mapa abierto desde archivo");
+
+    Pair* a=firstTreeMap(t);
+    Pair* b=firstTreeMap(f);
+    long count=0;
+    while(a!=NULL && b!=NULL && *(int*)a->key==*(int*)b->key){
+        a=nextTreeMap(t);
+        b=nextTreeMap(f);
+        count++;
+    }
+    int k=n/2;
+    if(a!=NULL || b!=NULL || count!=sizeTreeMap(t) || rankTreeMap(f,&k)!=rankTreeMap(t,&k)){
+        err_msg("firstTreeMap/nextTreeMap no recorren el archivo en orden");
+        return 0;
+    }
+    insertTreeMap(f,&keys[1],words[1]);
+    eraseTreeMap(f,&keys[0]);
+    if(sizeTreeMap(f)!=sizeTreeMap(t)){
+        err_msg("el mapa abierto desde archivo debe ser de solo lectura");
+        return 0;
+    }
+    ok_msg("iteracion en orden y mapa de solo lectura");
+    destroyTreeMap(f);
+
+    uint64_t bad=((uint64_t)1<<40)|1; //offset fuera del archivo
+    FILE* out=fopen(path,"r+b");
+    int ok=out!=NULL && fseek(out,sizeof(FlatHeader)+sizeof(uint64_t),SEEK_SET)==0 &&
+           fwrite(&bad,sizeof(bad),1,out)==1;
+    if(out!=NULL) fclose(out);
+    f=ok ? openTreeMap(path,lower_than_int) : NULL;
+    saveTreeMap(t,path,encode_int,encode_word);
+    TreeMap* g=truncate(path,sizeof(FlatHeader)+sizeTreeMap(t)*2*sizeof(uint64_t))==0 ?
+               openTreeMap(path,lower_than_int) : NULL;
+    if(!ok || f!=NULL || g!=NULL){
+        err_msg("openTreeMap debe rechazar archivos truncados o con offsets invalidos");
+        return 0;
+    }
+    ok_msg("openTreeMap rechaza archivos truncados o corruptos");
+
+    destroyTreeMap(t);
+    remove(path);
+    for(int i=0;i<n;i++) free(words[i]);
+    free(words);
+    free(keys);
+    return 1;
+}
+
+int check_rnode(RNode* x){
+    if(x==NULL) return 0;
+    int hl=check_rnode(x->left), hr=check_rnode(x->right);
+    if(hl<0 || hr<0 || hl-hr>1 || hr-hl>1 || x->height!=1+(hl>hr?hl:hr) ||
+       x->size!=1+rsize(x->left)+rsize(x->right)) return -1;
+    return x->height;
+}
+
+//recorre la version y verifica que tenga exactamente las claves pares < 2n
+long check_even_version(PersistentTreeMap* v, int n){
+    long count=0;
+    for(Pair* p=firstPersistentTreeMap(v);p!=NULL;p=nextPersistentTreeMap(v)){
+        if(*(int*)p->key!=2*count) return -1;
+        count++;
+    }
+    return count==n && sizePersistentTreeMap(v)==n ? count : -1;
+}
+
+typedef struct{
+    PersistentTreeMap* version;
+    int n;
+    long errors;
+}SnapshotArgs;
+
+void* snapshot_reader(void* arg){
+    SnapshotArgs* r=(SnapshotArgs*) arg;
+    for(int round=0;round<20;round++)
+        if(check_even_version(r->version,r->n)<0) r->errors++;
+    return NULL;
+}
+
+int persistent_test(){
+    int n=2000;
+    int* keys=crea_claves(2*n);
+    PersistentTreeMap* m=createPersistentTreeMap(lower_than_int);
+    srand(19);
+    for(int i=0;i<4*n;i++){
+        int k=2*(rand()%n);
+        insertPersistentTreeMap(m,&keys[k],&keys[k]);
+    }
+    for(int i=0;i<2*n;i+=2) insertPersistentTreeMap(m,&keys[i],&keys[i]);
+    if(check_even_version(m,n)<0 || check_rnode(m->root)<0){
+        err_msg("el mapa persistente no tiene las claves pares o no esta balanceado");
+        return 0;
+    }
+
+    info_msg("un hilo recorre una copia mientras se escribe en el mapa");
+    PersistentTreeMap* snap=snapshotPersistentTreeMap(m);
+    SnapshotArgs args={snap,n,0};
+    pthread_t th;
+    pthread_create(&th,NULL,snapshot_reader,&args);
+    for(int i=1;i<2*n;i+=2) insertPersistentTreeMap(m,&keys[i],&keys[i]);
+    for(int i=0;i<2*n;i+=4) erasePersistentTreeMap(m,&keys[i]);
+    pthread_join(th,NULL);
+    if(args.errors!=0 || check_even_version(snap,n)<0){
+        err_msg("la copia cambio mientras se escribia en el mapa");
+        return 0;
+    }
+    ok_msg("la copia no cambia con las escrituras");
+
+    long expected=2*n-(n+1)/2;
+    int k=4;
+    Pair* u=upperBoundPersistentTreeMap(m,&k);
+    if(sizePersistentTreeMap(m)!=expected || check_rnode(m->root)<0 ||
+       searchPersistentTreeMap(m,&keys[0])!=NULL || searchPersistentTreeMap(m,&keys[1])==NULL ||
+       u==NULL || u->key!=&keys[5]){
+        err_msg("search/upperBound/size incorrectos en el mapa modificado");
+        return 0;
+    }
+
+    PersistentTreeMap* snap2=snapshotPersistentTreeMap(snap);
+    erasePersistentTreeMap(snap2,&keys[2]);
+    if(searchPersistentTreeMap(snap,&keys[2])==NULL || searchPersistentTreeMap(snap2,&keys[2])!=NULL ||
+       sizePersistentTreeMap(snap2)!=n-1){
+        err_msg("escribir en una copia modifica la version original");
+        return 0;
+    }
+    ok_msg("search, upperBound y versiones independientes");
+
+    destroyPersistentTreeMap(m);
+    destroyPersistentTreeMap(snap2);
+    if(check_even_version(snap,n)<0){
+        err_msg("liberar otras versiones afecto a la copia");
+        return 0;
+    }
+    destroyPersistentTreeMap(snap);
+    free(keys);
+    return 1;
+}
+
+//mapa con las claves i donde in[i]!=0, insertadas en orden aleatorio
+TreeMap* crea_conjunto(int* keys, char* in, int n){
+    TreeMap* t=createTreeMap(lower_than_int);
+    for(int j=0;j<n;j++){
+        int i=rand()%n;
+        if(in[i]) insertTreeMap(t,&keys[i],&keys[i]);
+    }
+    for(int i=0;i<n;i++) if(in[i]) insertTreeMap(t,&keys[i],&keys[i]);
+    return t;
+}
+
+//verifica que t tenga exactamente las claves marcadas en expected
+int check_conjunto(TreeMap* t, char* expected, int n, const char* op){
+    long count=0;
+    for(int i=0;i<n;i++){
+        count+=expected[i];
+        if((searchTreeMap(t,&i)!=NULL)!=expected[i]){
+            sprintf(msg,"%s: la clave %d esta mal",op,i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    if(sizeTreeMap(t)!=count || check_avl(t->root,NULL)<0){
+        sprintf(msg,"%s: el resultado no esta balanceado o tiene %ld pares (se esperaban %ld)",op,sizeTreeMap(t),count);
+        err_msg(msg);
+        return 0;
+    }
+    return 1;
+}
+
+int join_test(){
+    int n=4000;
+    int* keys=crea_claves(n);
+    char* a=(char*) calloc(n,1);
+    char* b=(char*) calloc(n,1);
+    char* expected=(char*) calloc(n,1);
+    srand(23);
+    for(int i=0;i<n;i++){
+        a[i]=rand()%2;
+        b[i]=rand()%8==0; //b mucho mas chico que a
+    }
+
+    for(int op=0;op<3;op++){
+        const char* names[]={"unionTreeMap","intersectionTreeMap","differenceTreeMap"};
+        TreeMap* ta=crea_conjunto(keys,a,n);
+        TreeMap* tb=crea_conjunto(keys,b,n);
+        for(int i=0;i<n;i++)
+            expected[i]=op==0 ? a[i]||b[i] : op==1 ? a[i]&&b[i] : a[i]&&!b[i];
+        if(op==0) unionTreeMap(ta,tb);
+        else if(op==1) intersectionTreeMap(ta,tb);
+        else differenceTreeMap(ta,tb);
+        destroyTreeMap(tb); //ta puede tener nodos de tb
+        if(!check_conjunto(ta,expected,n,names[op])) return 0;
+        for(int i=0;i<n;i+=3) eraseTreeMap(ta,&keys[i]);
+        for(int i=0;i<n;i+=3) expected[i]=0;
+        if(!check_conjunto(ta,expected,n,names[op])) return 0;
+        destroyTreeMap(ta);
+    }
+    ok_msg("union, interseccion y diferencia correctas y balanceadas");
+
+    TreeMap* t=crea_conjunto(keys,a,n);
+    TreeMap* parts[4];
+    int cuts[3]={n/10,n/2,n/2+1};
+    parts[0]=t;
+    for(int c=2;c>=0;c--) parts[c+1]=splitTreeMap(t,&keys[cuts[c]]);
+    for(int c=0;c<4;c++){
+        int lo=c==0 ? 0 : cuts[c-1], hi=c==3 ? n : cuts[c];
+        for(int i=0;i<n;i++) expected[i]=a[i] && i>=lo && i<hi;
+        if(!check_conjunto(parts[c],expected,n,"splitTreeMap")) return 0;
+    }
+    for(int c=3;c>0;c--){
+        joinTreeMap(parts[c-1],parts[c]);
+        destroyTreeMap(parts[c]);
+    }
+    if(!check_conjunto(t,a,n,"joinTreeMap")) return 0;
+    ok_msg("splitTreeMap y joinTreeMap");
+
+    destroyTreeMap(t);
+    free(a);
+    free(b);
+    free(expected);
+    free(keys);
+    return 1;
+}
+
+int hint_test(){
+    int n=10000;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    TreeCursor hint={0};
+    for(int i=0;i<n/2;i++){
+        Pair* p=insertHintTreeMap(t,&hint,&keys[i],&keys[i]);
+        if(p==NULL || p->key!=&keys[i] || cursorPair(&hint)!=p){
+            err_msg("insertHintTreeMap no retorna el par insertado");
+            return 0;
+        }
+    }
+#ifdef TREEMAP_STATS
+    TreeMapStats st;
+    statsTreeMap(t,&st);
+    if(st.comparisons>4*(unsigned long long) (n/2)){
+        sprintf(msg,"%d inserciones en orden con pista hicieron %llu comparaciones",n/2,st.comparisons);
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("inserciones en orden con pista comparan solo con los vecinos");
+#endif
+
+    //hacia atras desde el final y luego pistas que no sirven
+    TreeCursor back={0};
+    for(int i=n-1;i>=3*n/4;i--) insertHintTreeMap(t,&back,&keys[i],&keys[i]);
+    srand(29);
+    for(int i=0;i<n;i++){
+        int k=rand()%n;
+        Pair* p=insertHintTreeMap(t,i%2 ? &hint : NULL,&keys[k],&keys[k]);
+        if(p==NULL || *(int*)p->key!=k){
+            err_msg("insertHintTreeMap con una pista lejana no inserta la clave");
+            return 0;
+        }
+    }
+    if(insertHintTreeMap(t,&hint,&keys[0],&keys[1])->value!=&keys[0]){
+        err_msg("insertHintTreeMap no debe reemplazar un par existente");
+        return 0;
+    }
+    long count=0;
+    for(Pair* p=firstTreeMap(t);p!=NULL;p=nextTreeMap(t)) count++;
+    if(check_avl(t->root,NULL)<0 || count!=sizeTreeMap(t) || searchTreeMap(t,&keys[n/2-1])==NULL ||
+       searchTreeMap(t,&keys[3*n/4])==NULL){
+        err_msg("el arbol no quedo balanceado o le faltan claves");
+        return 0;
+    }
+    ok_msg("pistas hacia atras, lejanas o NULL");
+
+    TreeMap* b=createBTreeMap(lower_than_int);
+    TreeCursor bh={0};
+    for(int i=0;i<n;i++) insertHintTreeMap(b,&bh,&keys[i],&keys[i]);
+    if(sizeTreeMap(b)!=n || cursorPair(&bh)->key!=&keys[n-1]){
+        err_msg("insertHintTreeMap en un B+tree");
+        return 0;
+    }
+    ok_msg("insertHintTreeMap en un B+tree");
+    destroyTreeMap(t);
+    destroyTreeMap(b);
+    free(keys);
+    return 1;
+}
+
+//verifica que next/prev de cada nodo coincidan con successor/predecessor
+int check_hilos(TreeMap* t, const char* op){
+    TreeNode* prev=NULL;
+    for(TreeNode* x=minimum(t->root);x!=NULL;x=avl_next(x)){
+        if(LINKS(x)->prev!=prev || (prev!=NULL && LINKS(prev)->next!=x)){
+            sprintf(msg,"%s: enlaces en orden incorrectos en la clave %d",op,*(int*)x->pair->key);
+            err_msg(msg);
+            return 0;
+        }
+        prev=x;
+    }
+    if(prev!=NULL && LINKS(prev)->next!=NULL){
+        sprintf(msg,"%s: el maximo tiene sucesor",op);
+        err_msg(msg);
+        return 0;
+    }
+    return 1;
+}
+
+int threaded_test(){
+    int n=3000;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    srand(31);
+    for(int i=0;i<n/2;i++){
+        int k=rand()%n;
+        insertTreeMap(t,&keys[k],&keys[k]);
+    }
+    threadTreeMap(t);
+    if(!check_hilos(t,"threadTreeMap")) return 0;
+    for(int i=0;i<2*n;i++){
+        int k=rand()%n;
+        if(rand()%2) insertTreeMap(t,&keys[k],&keys[k]);
+        else eraseTreeMap(t,&keys[k]);
+        if(i%97==0 && !check_hilos(t,"insert/erase")) return 0;
+    }
+    if(!check_hilos(t,"insert/erase")) return 0;
+    long count=0;
+    for(Pair* p=firstTreeMap(t);p!=NULL;p=nextTreeMap(t)) count++;
+    TreeCursor c;
+    long back=0;
+    for(Pair* p=lastCursor(&c,t);p!=NULL;p=prevCursor(&c)) back++;
+    if(count!=sizeTreeMap(t) || back!=count){
+        sprintf(msg,"nextTreeMap recorrio %ld y prevCursor %ld de %ld pares",count,back,sizeTreeMap(t));
+        err_msg(msg);
+        return 0;
+    }
+    ok_msg("enlaces correctos despues de insertar y eliminar");
+
+    TreeMap* b=createTreeMap(lower_than_int);
+    threadTreeMap(b);
+    Pair* pairs=(Pair*) malloc(sizeof(Pair)*n);
+    for(int i=0;i<n;i++){ pairs[i].key=&keys[i]; pairs[i].value=&keys[i]; }
+    buildTreeMap(b,pairs,n);
+    if(!check_hilos(b,"buildTreeMap")) return 0;
+    TreeMap* up=splitTreeMap(b,&keys[n/3]);
+    if(!check_hilos(b,"splitTreeMap") || !check_hilos(up,"splitTreeMap")) return 0;
+    joinTreeMap(b,up);
+    destroyTreeMap(up);
+    if(!check_hilos(b,"joinTreeMap")) return 0;
+    unionTreeMap(t,b);
+    destroyTreeMap(b);
+    if(!check_hilos(t,"unionTreeMap") || sizeTreeMap(t)!=n) return 0;
+    TreeCursor hint={0};
+    TreeMap* h=createTreeMap(lower_than_int);
+    threadTreeMap(h);
+    for(int i=n-1;i>=0;i-=2) insertHintTreeMap(h,&hint,&keys[i],&keys[i]);
+    if(!check_hilos(h,"insertHintTreeMap")) return 0;
+    //los nodos de un mapa sin enlaces se copian al unirlos a uno enhebrado
+    TreeMap* plano=createTreeMap(lower_than_int);
+    for(int i=0;i<n;i+=3) insertTreeMap(plano,&keys[i],&keys[i]);
+    unionTreeMap(h,plano);
+    destroyTreeMap(plano);
+    if(!check_hilos(h,"unionTreeMap con un mapa sin enlaces")) return 0;
+    ok_msg("enlaces correctos con build, split, join, union y pistas");
+
+    destroyTreeMap(t);
+    destroyTreeMap(h);
+    free(pairs);
+    free(keys);
+    return 1;
+}
+
+//como range_visit pero de mayor a menor; se detiene al bajar de limit
+int reverse_visit(Pair* p, void* data){
+    RangeState* st=(RangeState*) data;
+    if(*((int*)p->key)!=st->next) st->next=1000000;
+    st->next-=2;
+    return st->next>st->limit;
+}
+
+//t tiene las claves pares 0..998
+int reverse_check(TreeMap* t){
+    int expected=998;
+    for(Pair* p=lastTreeMap(t);p!=NULL;p=prevTreeMap(t)){
+        if(*((int*)p->key)!=expected){
+            sprintf(msg,"prevTreeMap retorna %d, se esperaba %d",*((int*)p->key),expected);
+            err_msg(msg);
+            return 0;
+        }
+        expected-=2;
+    }
+    if(expected!=-2){
+        err_msg("lastTreeMap/prevTreeMap no recorren todo el mapa");
+        return 0;
+    }
+    int k=500;
+    searchTreeMap(t,&k);
+    if(prevTreeMap(t)==NULL || *((int*)prevTreeMap(t)->key)!=496 || *((int*)nextTreeMap(t)->key)!=498){
+        err_msg("prevTreeMap despues de searchTreeMap");
+        return 0;
+    }
+    ok_msg("lastTreeMap/prevTreeMap recorren de mayor a menor");
+
+    int lo=11, hi=101;
+    RangeState st={100,-1000000};
+    long visited=rangeReverseTreeMap(t,&lo,&hi,reverse_visit,&st);
+    if(visited!=45 || st.next!=10){
+        sprintf(msg,"rango inverso [11,101) visita %ld pares",visited);
+        err_msg(msg);
+        return 0;
+    }
+    hi=100;
+    st.next=98; st.limit=-1000000;
+    if(rangeReverseTreeMap(t,&lo,&hi,reverse_visit,&st)!=44 || st.next!=10){
+        err_msg("rango inverso con hi en el mapa");
+        return 0;
+    }
+    //ultimas 10 claves
+    st.next=998; st.limit=978;
+    visited=rangeReverseTreeMap(t,NULL,NULL,reverse_visit,&st);
+    if(visited!=10 || st.next!=978){
+        err_msg("el recorrido inverso no se detiene cuando visit retorna 0");
+        return 0;
+    }
+    hi=-5;
+    if(rangeReverseTreeMap(t,NULL,&hi,NULL,NULL)!=0 || rangeReverseTreeMap(t,NULL,NULL,NULL,NULL)!=500){
+        err_msg("rangeReverseTreeMap cuenta mal los pares");
+        return 0;
+    }
+    ok_msg("rangeReverseTreeMap visita de mayor a menor");
+    destroyTreeMap(t);
+    return 1;
+}
+
+int reverse_test(){
+    int n=500;
+    int* keys=(int*) malloc(sizeof(int)*n);
+    TreeMap* a=createTreeMap(lower_than_int);
+    TreeMap* b=createBTreeMap(lower_than_int);
+    TreeMap* c=createTreeMap(lower_than_int);
+    threadTreeMap(c);
+    srand(37);
+    for(int i=0;i<n;i++) keys[i]=2*i;
+    for(int i=0;i<3*n;i++){ //en desorden
+        int k=rand()%n;
+        insertTreeMap(a,&keys[k],&keys[k]);
+        insertTreeMap(b,&keys[k],&keys[k]);
+        insertTreeMap(c,&keys[k],&keys[k]);
+    }
+    for(int i=0;i<n;i++){
+        insertTreeMap(a,&keys[i],&keys[i]);
+        insertTreeMap(b,&keys[i],&keys[i]);
+        insertTreeMap(c,&keys[i],&keys[i]);
+    }
+    info_msg("recorrido inverso en el arbol binario");
+    int ok=reverse_check(a);
+    info_msg("recorrido inverso en el B+tree");
+    ok=ok && reverse_check(b);
+    info_msg("recorrido inverso en el mapa enhebrado");
+    ok=ok && reverse_check(c);
+    free(keys);
+    return ok;
+}
+
+//acumulador que solo es correcto si los pares llegan en orden
+typedef struct{
+    long count;
+    long sum;
+    int first, last;
+    int ordered;
+}OrderAcc;
+
+void order_fold(void* acc, Pair* p, void* data){
+    OrderAcc* a=(OrderAcc*) acc;
+    int k=*(int*)p->key;
+    if(a->count==0) a->first=k;
+    else if(k!=a->last+1) a->ordered=0;
+    a->last=k;
+    a->count++;
+    a->sum+=k;
+}
+
+void order_combine(void* acc, void* other, void* data){
+    OrderAcc* a=(OrderAcc*) acc;
+    OrderAcc* b=(OrderAcc*) other;
+    if(b->count==0) return;
+    if(a->count==0) a->first=b->first;
+    else if(b->first!=a->last+1) a->ordered=0;
+    a->ordered=a->ordered && b->ordered;
+    a->last=b->last;
+    a->count+=b->count;
+    a->sum+=b->sum;
+}
+
+void rank_visit(Pair* p, long rank, void* data){
+    ((int*) data)[rank]=*(int*)p->key;
+}
+
+int parallel_check(TreeMapPool* pool, TreeMap* t, int n, const char* name){
+    OrderAcc acc={0,0,0,0,1};
+    if(!reduceTreeMap(pool,t,&acc,sizeof(OrderAcc),order_fold,order_combine,NULL) ||
+       acc.count!=n || acc.sum!=(long) n*(n-1)/2 || !acc.ordered || acc.last!=n-1){
+        sprintf(msg,"%s: reduceTreeMap conto %ld pares (orden %d)",name,acc.count,acc.ordered);
+        err_msg(msg);
+        return 0;
+    }
+    int* out=(int*) malloc(sizeof(int)*n);
+    for(int i=0;i<n;i++) out[i]=-1;
+    forEachTreeMap(pool,t,rank_visit,out);
+    for(int i=0;i<n;i++){
+        if(out[i]!=i){
+            sprintf(msg,"%s: forEachTreeMap dejo %d en la posicion %d",name,out[i],i);
+            err_msg(msg);
+            return 0;
+        }
+    }
+    free(out);
+    sprintf(msg,"%s: reduceTreeMap y forEachTreeMap en orden",name);
+    ok_msg(msg);
+    return 1;
+}
+
+int parallel_test(){
+    int n=100000;
+    int* keys=crea_claves(n);
+    Pair* pairs=(Pair*) malloc(sizeof(Pair)*n);
+    for(int i=0;i<n;i++){ pairs[i].key=&keys[i]; pairs[i].value=&keys[i]; }
+    TreeMapPool* pool=createTreeMapPool(4);
+
+    TreeMap* a=createTreeMap(lower_than_int);
+    TreeMap* b=createBTreeMap(lower_than_int);
+    srand(41);
+    for(int i=0;i<n;i++){
+        int k=rand()%n;
+        insertTreeMap(a,&keys[k],&keys[k]);
+    }
+    for(int i=0;i<n;i++){
+        insertTreeMap(a,&keys[i],&keys[i]);
+        insertTreeMap(b,&keys[i],&keys[i]);
+    }
+    if(!parallel_check(pool,a,n,"arbol binario") || !parallel_check(pool,b,n,"B+tree") ||
+       !parallel_check(NULL,a,n,"sin pool")) return 0;
+
+    TreeMap* c=createTreeMap(lower_than_int);
+    threadTreeMap(c);
+    buildParallelTreeMap(pool,c,pairs,n);
+    if(check_avl(c->root,NULL)<0 || sizeTreeMap(c)!=n){
+        err_msg("buildParallelTreeMap no construye un AVL con todos los pares");
+        return 0;
+    }
+    if(!check_hilos(c,"buildParallelTreeMap") || !parallel_check(pool,c,n,"buildParallelTreeMap")) return 0;
+    TreeMap* e=createTreeMap(lower_than_int);
+    TreeMapPool* one=createTreeMapPool(1);
+    OrderAcc acc={0,0,0,0,1};
+    reduceTreeMap(one,e,&acc,sizeof(OrderAcc),order_fold,order_combine,NULL);
+    if(acc.count!=0){
+        err_msg("reduceTreeMap sobre un mapa vacio");
+        return 0;
+    }
+    ok_msg("mapa vacio y pool de un hilo");
+
+    destroyTreeMapPool(pool);
+    destroyTreeMapPool(one);
+    destroyTreeMap(a);
+    destroyTreeMap(b);
+    destroyTreeMap(c);
+    destroyTreeMap(e);
+    free(pairs);
+    free(keys);
+    return 1;
+}
+
+int splay_test(){
+    int n=20000;
+    int* keys=crea_claves(n);
+    TreeMap* t=createSplayTreeMap(lower_than_int);
+    srand(43);
+    for(int i=0;i<n;i++){
+        int k=rand()%n;
+        insertTreeMap(t,&keys[k],&keys[k]);
+    }
+    for(int i=0;i<n;i+=2) insertTreeMap(t,&keys[i],&keys[i]);
+    int hot=777;
+    if(searchTreeMap(t,&keys[hot])==NULL || t->root->pair->key!=&keys[hot]){
+        err_msg("searchTreeMap no sube la clave buscada a la raiz");
+        return 0;
+    }
+    ok_msg("searchTreeMap sube la clave buscada a la raiz");
+    int again=1234;
+    TreeCursor hint={0};
+    insertTreeMap(t,&keys[again],&keys[again]);
+    if(t->root->pair->key!=&keys[again]){
+        err_msg("insertTreeMap de una clave existente no la sube a la raiz");
+        return 0;
+    }
+    insertHintTreeMap(t,&hint,&keys[again+2],&keys[again+2]);
+    insertHintTreeMap(t,&hint,&keys[again],&keys[again]);
+    if(t->root->pair->key!=&keys[again]){
+        err_msg("insertHintTreeMap de una clave existente no la sube a la raiz");
+        return 0;
+    }
+    ok_msg("reinsertar una clave existente la sube a la raiz");
+
+    for(int i=0;i<n;i+=3) eraseTreeMap(t,&keys[i]);
+    for(int i=0;i<2000;i++) searchTreeMap(t,&keys[rand()%n]);
+    long count=0, prev=-1;
+    for(Pair* p=firstTreeMap(t);p!=NULL;p=nextTreeMap(t)){
+        if(*(int*)p->key<=prev){
+            err_msg("el recorrido no queda en orden");
+            return 0;
+        }
+        prev=*(int*)p->key;
+        count++;
+    }
+    if(count!=sizeTreeMap(t) || t->root->parent!=NULL){
+        sprintf(msg,"sizeTreeMap %ld, el recorrido visita %ld",sizeTreeMap(t),count);
+        err_msg(msg);
+        return 0;
+    }
+    for(long k=0;k<count;k+=97){
+        Pair* p=selectTreeMap(t,k);
+        if(p==NULL || rankTreeMap(t,p->key)!=k){
+            err_msg("rank/select incorrectos: los tamanos no se mantienen al rotar");
+            return 0;
+        }
+    }
+    int lo=100, hi=200;
+    long expected=0;
+    for(int i=lo;i<hi;i++) expected+=lookupTreeMap(t,&keys[i])!=NULL;
+    if(rangeTreeMap(t,&lo,&hi,NULL,NULL)!=expected || countRangeTreeMap(t,&lo,&hi)!=expected){
+        err_msg("rangos en el mapa splay");
+        return 0;
+    }
+    if(splitTreeMap(t,&keys[n/2])!=NULL){
+        err_msg("splitTreeMap no debe aceptar un mapa splay");
+        return 0;
+    }
+    ok_msg("orden, rank/select y rangos despues de insertar, buscar y eliminar");
+
+    //en orden el arbol queda como una lista: nada puede ser recursivo
+    TreeMap* deep=createSplayTreeMap(lower_than_int);
+    for(int i=0;i<n;i++) insertTreeMap(deep,&keys[i],&keys[i]);
+#ifdef TREEMAP_STATS
+    TreeMapStats st;
+    statsTreeMap(deep,&st);
+    if(st.entries!=n || st.maxDepth!=n){
+        sprintf(msg,"stats: %ld pares, profundidad maxima %d",st.entries,st.maxDepth);
+        err_msg(msg);
+        return 0;
+    }
+#endif
+    TreeMapPool* pool=createTreeMapPool(2);
+    int* out=(int*) malloc(sizeof(int)*n);
+    forEachTreeMap(pool,deep,rank_visit,out);
+    for(int i=0;i<n;i++){
+        if(out[i]!=i){
+            err_msg("forEachTreeMap en un mapa splay");
+            return 0;
+        }
+    }
+    searchTreeMap(deep,&keys[0]); //recorre toda la lista y la acorta
+#ifdef TREEMAP_STATS
+    statsTreeMap(deep,&st);
+    if(st.maxDepth>n/2+2){
+        sprintf(msg,"buscar la clave mas profunda deja profundidad %d",st.maxDepth);
+        err_msg(msg);
+        return 0;
+    }
+#endif
+    ok_msg("mapa splay degenerado: stats, recorrido paralelo y destroy");
+
+    destroyTreeMapPool(pool);
+    destroyTreeMap(deep);
+    destroyTreeMap(t);
+    free(out);
+    free(keys);
+    return 1;
+}
+
+unsigned long hash_int(void* key){
+    return (unsigned long) *((int*) key);
+}
+
+//hash con muchas colisiones para probar el borrado del indice
+unsigned long hash_mod(void* key){
+    return (unsigned long) (*((int*) key) % 13);
+}
+
+//compara t (indexado) con el recorrido del arbol para las claves 0..n-1
+int check_indice(TreeMap* t, int* keys, int n, const char* op){
+    long count=0;
+    for(int i=0;i<n;i++){
+        TreeNode* node=ceilingNode(t,&keys[i],0);
+        if(node!=NULL && node->pair->key!=&keys[i]) node=NULL;
+        if(lookupTreeMap(t,&keys[i])!=(node==NULL ? NULL : node->pair)){
+            sprintf(msg,"%s: el indice no coincide con el arbol en la clave %d",op,i);
+            err_msg(msg);
+            return 0;
+        }
+        count+=node!=NULL;
+    }
+    if(t->index==NULL || t->index->count!=count || count!=sizeTreeMap(t)){
+        sprintf(msg,"%s: el indice tiene %ld claves y el arbol %ld",op,t->index==NULL ? -1 : t->index->count,sizeTreeMap(t));
+        err_msg(msg);
+        return 0;
+    }
+    return 1;
+}
+
+int index_test(){
+    int n=5000;
+    int* keys=crea_claves(n);
+    TreeMap* t=createTreeMap(lower_than_int);
+    srand(47);
+    for(int i=0;i<n/2;i++){
+        int k=rand()%n;
+        insertTreeMap(t,&keys[k],&keys[k]);
+    }
+    if(!indexTreeMap(t,hash_int) || !check_indice(t,keys,n,"indexTreeMap")) return 0;
+    for(int i=0;i<3*n;i++){
+        int k=rand()%n;
+        if(rand()%2) insertTreeMap(t,&keys[k],&keys[k]);
+        else eraseTreeMap(t,&keys[k]);
+    }
+    if(!check_indice(t,keys,n,"insert/erase")) return 0;
+    long hits=0;
+#ifdef TREEMAP_STATS
+    resetStatsTreeMap(t);
+    for(int i=0;i<n;i++) hits+=searchTreeMap(t,&keys[i])!=NULL;
+    TreeMapStats st;
+    statsTreeMap(t,&st);
+    if(hits!=sizeTreeMap(t) || st.comparisons>(unsigned long long) 2*n){
+        sprintf(msg,"%d busquedas con indice hicieron %llu comparaciones",n,st.comparisons);
+        err_msg(msg);
+        return 0;
+    }
+#else
+    for(int i=0;i<n;i++) hits+=searchTreeMap(t,&keys[i])!=NULL;
+    if(hits!=sizeTreeMap(t)){
+        err_msg("searchTreeMap con indice no encuentra todas las claves");
+        return 0;
+    }
+#endif
+    int k=n/2;
+    if(upperBound(t,&k)==NULL || *((int*)upperBound(t,&k)->key)<k){
+        err_msg("upperBound con indice");
+        return 0;
+    }
+    ok_msg("el indice sigue al arbol y las busquedas comparan una vez");
+
+    TreeMap* c=createTreeMap(lower_than_int);
+    indexTreeMap(c,hash_mod);
+    for(int i=0;i<500;i++) insertTreeMap(c,&keys[i],&keys[i]);
+    for(int i=0;i<2000;i++){
+        int j=rand()%500;
+        if(rand()%2) eraseTreeMap(c,&keys[j]);
+        else insertTreeMap(c,&keys[j],&keys[j]);
+    }
+    if(!check_indice(c,keys,500,"colisiones")) return 0;
+    ok_msg("eliminar con muchas colisiones");
+
+    TreeMap* up=splitTreeMap(t,&keys[n/3]);
+    if(!check_indice(t,keys,n,"splitTreeMap") || !check_indice(up,keys,n,"splitTreeMap")) return 0;
+    unionTreeMap(t,c);
+    joinTreeMap(t,up);
+    if(!check_indice(t,keys,n,"union/join") || !check_indice(c,keys,n,"union")) return 0;
+
+    TreeMap* sp=createSplayTreeMap(lower_than_int);
+    indexTreeMap(sp,hash_int);
+    Pair* pairs=(Pair*) malloc(sizeof(Pair)*n);
+    for(int i=0;i<n;i++){ pairs[i].key=&keys[i]; pairs[i].value=&keys[i]; }
+    TreeMap* b=createTreeMap(lower_than_int);
+    indexTreeMap(b,hash_int);
+    buildTreeMap(b,pairs,n);
+    for(int i=0;i<n;i+=2){
+        insertTreeMap(sp,&keys[i],&keys[i]);
+        eraseTreeMap(b,&keys[i]);
+    }
+    searchTreeMap(sp,&keys[10]);
+    if(!check_indice(sp,keys,n,"splay") || sp->root->pair->key!=&keys[10] || !check_indice(b,keys,n,"buildTreeMap")) return 0;
+    ok_msg("split, union, join, build y splay con indice");
+
+    destroyTreeMap(t);
+    destroyTreeMap(c);
+    destroyTreeMap(up);
+    destroyTreeMap(sp);
+    destroyTreeMap(b);
+    free(pairs);
+    free(keys);
+    return 1;
+}
 
 int main( int argc, char *argv[] ) {
     TreeMap * tree;
     int total_score=0;
+    int max_score=200;
     int all_correct=1;
     
     if(argc>1) test_id=atoi(argv[1]);
@@ -597,8 +2345,230 @@ int main( int argc, char *argv[] ) {
       total_score+=score;   
     }
 
+    if(test_id==-1 || test_id==12){
+      score=0;
+      printf("\nTest balanceo AVL...\n");
+      all_correct &=balance_test1()&&
+      balance_test2()&&
+      balance_test3()&&
+      (score+=10) && (test_id!=12 || success());
+      printf("   partial_score: %d/10\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==13){
+      score=0;
+      printf("\nTest pool de nodos...\n");
+      all_correct &=pool_test()&&
+      (score+=5) && (test_id!=13 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==14){
+      score=0;
+      printf("\nTest cotas sin reserva de memoria...\n");
+      all_correct &=bounds_test()&&
+      (score+=5) && (test_id!=14 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==15){
+      score=0;
+      printf("\nTest comparador de tres vias...\n");
+      all_correct &=compare_mode_test()&&
+      (score+=5) && (test_id!=15 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==16){
+      score=0;
+      printf("\nTest B+tree...\n");
+      all_correct &=btree_test()&&
+      (score+=10) && (test_id!=16 || success());
+      printf("   partial_score: %d/10\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==17){
+      score=0;
+      printf("\nTest cursores...\n");
+      all_correct &=cursor_test()&&
+      (score+=5) && (test_id!=17 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==18){
+      score=0;
+      printf("\nTest mapa concurrente...\n");
+      all_correct &=concurrent_test()&&
+      (score+=5) && (test_id!=18 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==19){
+      score=0;
+      printf("\nTest carga masiva...\n");
+      all_correct &=build_test()&&
+      (score+=5) && (test_id!=19 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==20){
+      score=0;
+      printf("\nTest recorrido por rango...\n");
+      all_correct &=range_test()&&
+      (score+=5) && (test_id!=20 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==21){
+      score=0;
+      printf("\nTest busqueda por lotes...\n");
+      all_correct &=batch_test()&&
+      (score+=5) && (test_id!=21 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==22){
+      score=0;
+      printf("\nTest rank/select...\n");
+      all_correct &=order_test()&&
+      (score+=5) && (test_id!=22 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==23){
+      score=0;
+      printf("\nTest mapa de claves enteras...\n");
+      all_correct &=int_map_test()&&
+      (score+=5) && (test_id!=23 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==24){
+      score=0;
+      printf("\nTest mapa de strings...\n");
+      all_correct &=string_map_test()&&
+      (score+=5) && (test_id!=24 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==25){
+      score=0;
+      printf("\nTest mapa generico (treemap_gen.h)...\n");
+      all_correct &=generic_test()&&
+      (score+=5) && (test_id!=25 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+#ifdef TREEMAP_STATS
+    if(test_id==-1 || test_id==26){
+      score=0;
+      printf("\nTest estadisticas (TREEMAP_STATS)...\n");
+      all_correct &=stats_test()&&
+      (score+=5) && (test_id!=26 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+#else
+    max_score-=5;
+#endif
+
+    if(test_id==-1 || test_id==27){
+      score=0;
+      printf("\nTest archivo plano (saveTreeMap/openTreeMap)...\n");
+      all_correct &=snapshot_test()&&
+      (score+=5) && (test_id!=27 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==28){
+      score=0;
+      printf("\nTest mapa persistente...\n");
+      all_correct &=persistent_test()&&
+      (score+=5) && (test_id!=28 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==29){
+      score=0;
+      printf("\nTest join/split/union...\n");
+      all_correct &=join_test()&&
+      (score+=5) && (test_id!=29 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==30){
+      score=0;
+      printf("\nTest insercion con pista...\n");
+      all_correct &=hint_test()&&
+      (score+=5) && (test_id!=30 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==31){
+      score=0;
+      printf("\nTest mapa enhebrado...\n");
+      all_correct &=threaded_test()&&
+      (score+=5) && (test_id!=31 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==32){
+      score=0;
+      printf("\nTest recorrido inverso...\n");
+      all_correct &=reverse_test()&&
+      (score+=5) && (test_id!=32 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==33){
+      score=0;
+      printf("\nTest recorrido y construccion en paralelo...\n");
+      all_correct &=parallel_test()&&
+      (score+=5) && (test_id!=33 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==34){
+      score=0;
+      printf("\nTest mapa splay...\n");
+      all_correct &=splay_test()&&
+      (score+=5) && (test_id!=34 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
+    if(test_id==-1 || test_id==35){
+      score=0;
+      printf("\nTest indice hash...\n");
+      all_correct &=index_test()&&
+      (score+=5) && (test_id!=35 || success());
+      printf("   partial_score: %d/5\n", score);
+      total_score+=score;
+    }
+
     if(argc==1)
-      printf("\ntotal_score: %d/70\n", total_score);
+      printf("\ntotal_score: %d/%d\n", total_score, max_score);
 
     
 
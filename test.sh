@@ -14,18 +14,22 @@ git config --global user.name "Your Name"
 CHANGED=$(git diff --ignore-space-at-eol -b -w --ignore-blank-lines $target_file)
 
 #Si hubieron cambios se actualiza el log
-if [ -n "$CHANGED" ] || [ ! -f "a.out" ]; then
+if [ -n "$CHANGED" ] || [ ! -f "a.out" ] || [ ! -f "a_stats.out" ]; then
   git checkout -- $testcode log &> /dev/null
   #exec 1>>log 2>&1
 
   echo "$(date): " >> log
   git diff --stat --ignore-space-at-eol -b -w --ignore-blank-lines $target_file >> log
 
-  #Compilation
+  #Compilation: sin y con las estadisticas (TREEMAP_STATS)
   echo "Compiling with: gcc $testcode -Wall -Werror -o a.out" >&3
-  if gcc $testcode -Wall -Werror -o a.out 2>>log ; then
+  echo "Compiling with: gcc -DTREEMAP_STATS $testcode -Wall -Werror -o a_stats.out" >&3
+  if gcc $testcode -Wall -Werror -o a.out 2>>log &&
+     gcc -DTREEMAP_STATS $testcode -Wall -Werror -o a_stats.out 2>>log ; then
       echo  " tests: " $(($(./a.out | grep -c 'OK')))\|$(($(./a.out | grep -c 'FAILED'))) >> log
       ./a.out | tail -n1 >> log
+      echo  " tests (TREEMAP_STATS): " $(($(./a_stats.out | grep -c 'OK')))\|$(($(./a_stats.out | grep -c 'FAILED'))) >> log
+      ./a_stats.out | tail -n1 >> log
       git rev-parse --short HEAD >> log
       #git add and commit
       git add $target_file log &> /dev/null 
@@ -34,6 +38,7 @@ if [ -n "$CHANGED" ] || [ ! -f "a.out" ]; then
       echo "Compilation with errors :c" >&3
       echo "Compilation failed" >> log
       gcc $testcode -Wall -Werror -o a.out 2>&3
+      gcc -DTREEMAP_STATS $testcode -Wall -Werror -o a_stats.out 2>&3
       git rev-parse --short HEAD >> log
       #git add and commit
       git add $target_file log &> /dev/null 
@@ -46,11 +51,14 @@ fi
 
 #Retroalimentation
 
-if ./a.out &> /dev/null ; then
+if ./a.out &> /dev/null && ./a_stats.out &> /dev/null ; then
   echo "Executing: ./a.out" >&3
   
   ./a.out >&3
 
+  echo "Executing: ./a_stats.out" >&3
+  ./a_stats.out | tail -n1 >&3
+
 
 
   echo "Quiere actualizar su avance en el servidor? (s|n): " >&3
@@ -1,7 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "treemap.h"
+#include "treemap_gen.h"
 
 typedef struct TreeNode TreeNode;
 
@@ -10,31 +19,384 @@ struct TreeNode {
     TreeNode * left;
     TreeNode * right;
     TreeNode * parent;
+    int size; //cantidad de nodos del subarbol
+    unsigned char height;
+    unsigned char pooled;
+    Pair entry;
 };
 
+//nodo de un mapa enhebrado: los enlaces van despues del nodo, asi los
+//mapas que no se enhebran no pagan esos 16 bytes
+typedef struct ThreadedNode {
+    TreeNode node;
+    TreeNode * next; //sucesor y predecesor en orden
+    TreeNode * prev;
+} ThreadedNode;
+
+#define LINKS(x) ((ThreadedNode *)(x))
+
+//en mapas de strings cada nodo termina con los primeros 8 bytes de su
+//clave (despues de los enlaces si esta enhebrado); los demas no los llevan
+#define PREFIX(tree, x) (*(unsigned long long *)((char *)(x) + (tree)->pool.nodeSize - sizeof(unsigned long long)))
+
+//los nodos se reservan por bloques (slabs) y se reciclan con una lista libre
+typedef struct NodeSlab NodeSlab;
+
+struct NodeSlab {
+    NodeSlab * next;
+    TreeNode nodes[];
+};
+
+//slabs de mapas que intercambiaron nodos (split, join, union...): se
+//liberan juntas cuando se destruye el ultimo de esos mapas. Al unir dos
+//grupos uno reenvia al otro (forward) y queda en su lista absorbed
+typedef struct SlabOwner SlabOwner;
+
+struct SlabOwner {
+    NodeSlab * slabs;
+    int refs; //mapas del grupo; solo cuenta en la raiz
+    SlabOwner * forward;
+    SlabOwner * absorbed;
+};
+
+typedef struct NodePool {
+    NodeSlab * slabs;
+    TreeNode * freeList;
+    char * slabNext;
+    char * slabEnd;
+    size_t slabSize;
+    size_t nodeSize; //sizeof(TreeNode), o sizeof(ThreadedNode) si el mapa esta enhebrado
+    SlabOwner * shared; //NULL si ningun otro mapa tiene nodos de estas slabs
+} NodePool;
+
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr) ((void) 0)
+#endif
+
+//contadores de TREEMAP_STATS; sin la opcion no generan codigo
+#ifdef TREEMAP_STATS
+#define ADD_STAT(tree, field, n) ((tree)->stats.field += (n))
+#else
+#define ADD_STAT(tree, field, n) ((void) 0)
+#endif
+#define COUNT_STAT(tree, field) ADD_STAT(tree, field, 1)
+
+#define POOL_MIN_SLAB 64
+#define POOL_MAX_SLAB 4096
+
+//B+tree: los pares viven en hojas enlazadas, los nodos internos solo guian
+#define BTREE_ORDER 32
+#define BTREE_LEAF_MAX 32
+#define BTREE_INNER_MIN ((BTREE_ORDER - 1) / 2)
+#define BTREE_LEAF_MIN (BTREE_LEAF_MAX / 2)
+
+typedef struct BNode {
+    int leaf;
+    int count; //claves en un nodo interno, pares en una hoja
+} BNode;
+
+typedef struct BInner {
+    BNode hdr;
+    void * keys[BTREE_ORDER - 1];
+    BNode * children[BTREE_ORDER];
+    long counts[BTREE_ORDER]; //pares bajo cada hijo, para rank/select
+} BInner;
+
+typedef struct BLeaf BLeaf;
+
+struct BLeaf {
+    BNode hdr;
+    BLeaf * next;
+    BLeaf * prev;
+    Pair pairs[BTREE_LEAF_MAX];
+};
+
+typedef struct BTree {
+    BNode * root;
+    BLeaf * curLeaf;
+    int curIndex;
+    long size;
+    BNode * spare; //internos reservados para divisiones, enlazados por children[0]
+    int spareCount;
+    BNode * spareLeaf;
+} BTree;
+
+//archivo de saveTreeMap: cabecera, indice de pares ordenado por clave y
+//datos codificados (cada uno alineado a 8 bytes). En el indice key y value
+//son offsets desde el inicio del archivo con el bit 0 encendido
+#define FLAT_MAGIC "TREEMAP1"
+
+typedef struct FlatHeader {
+    char magic[8];
+    uint64_t count;
+} FlatHeader;
+
+typedef struct FlatMap {
+    char * base; //archivo mapeado de solo lectura
+    size_t length;
+    long count;
+    Pair * index; //indice del archivo con los offsets ya cambiados por punteros
+    long cur; //posicion de current, -1 si no hay
+} FlatMap;
+
+typedef struct HashSlot {
+    unsigned long hash;
+    TreeNode * node; //NULL: casilla libre
+} HashSlot;
+
+typedef struct HashIndex {
+    unsigned long (*hash) (void* key);
+    HashSlot * slots; //2^bits casillas, sondeo lineal
+    int bits;
+    long count;
+} HashIndex;
+
 struct TreeMap {
     TreeNode * root;
     TreeNode * current;
     int (*lower_than) (void* key1, void* key2);
+    int (*compare) (void* key1, void* key2);
+    NodePool pool;
+    BTree * btree; //NULL salvo en mapas creados con createBTreeMap
+    FlatMap * file; //NULL salvo en mapas abiertos con openTreeMap
+    HashIndex * index; //NULL salvo despues de indexTreeMap
+    int stringKeys; //claves char* comparadas usando el prefijo de cada nodo
+    int threaded; //los nodos mantienen next/prev (threadTreeMap)
+    int splay; //sin balance AVL: cada acceso sube el nodo a la raiz
+#ifdef TREEMAP_STATS
+    TreeMapStats stats; //solo se usan los contadores
+#endif
 };
 
+//retorna <0, 0 o >0 segun key1 sea menor, igual o mayor que key2
+int compareKeys(TreeMap* tree, void* key1, void* key2){
+    COUNT_STAT(tree, comparisons);
+    if(tree->compare!=NULL) return tree->compare(key1,key2);
+    if(tree->lower_than(key1,key2)) return -1;
+    COUNT_STAT(tree, comparisons);
+    return tree->lower_than(key2,key1);
+}
+
+//una sola llamada al comparador en ambos modos
+int lowerThan(TreeMap* tree, void* key1, void* key2){
+    COUNT_STAT(tree, comparisons);
+    if(tree->compare!=NULL) return tree->compare(key1,key2)<0;
+    return tree->lower_than(key1,key2);
+}
+
+//primeros 8 bytes del string en orden big-endian, rellenos con ceros:
+//comparar dos prefijos como enteros equivale a comparar esos bytes
+unsigned long long keyPrefix(const char* key){
+    unsigned long long prefix = 0;
+    for(int i = 0; i < 8; i++){
+        prefix <<= 8;
+        if(*key != '\0') prefix |= (unsigned char) *key++;
+    }
+    return prefix;
+}
+
+unsigned long long probePrefix(TreeMap* tree, void* key){
+    return tree->stringKeys ? keyPrefix((const char*) key) : 0;
+}
+
+//compara key con la clave de node; en mapas de strings casi siempre
+//decide el prefijo guardado en el nodo sin leer la clave
+int compareNode(TreeMap* tree, void* key, unsigned long long prefix, TreeNode* node){
+    if(!tree->stringKeys){
+        COUNT_STAT(tree, comparisons);
+        return tree->compare(key,node->pair->key);
+    }
+    unsigned long long stored = PREFIX(tree, node);
+    if(prefix!=stored) return prefix<stored ? -1 : 1;
+    if((prefix & 0xff)==0) return 0; //ambos terminan dentro del prefijo
+    COUNT_STAT(tree, comparisons);
+    return strcmp((const char*) key+8,(const char*) node->pair->key+8);
+}
+
 int is_equal(TreeMap* tree, void* key1, void* key2){
-    if(tree->lower_than(key1,key2)==0 &&  
-        tree->lower_than(key2,key1)==0) return 1;
+    if(compareKeys(tree,key1,key2)==0) return 1;
     else return 0;
 }
 
 
+//nodo suelto, sin espacio para el prefijo ni los enlaces (ver PREFIX y LINKS)
 TreeNode * createTreeNode(void* key, void * value) {
     TreeNode * new = (TreeNode *)malloc(sizeof(TreeNode));
     if (new == NULL) return NULL;
-    new->pair = (Pair *)malloc(sizeof(Pair));
+    new->pair = &new->entry;
+    new->pair->key = key;
+    new->pair->value = value;
+    new->parent = new->left = new->right = NULL;
+    new->height = 1;
+    new->size = 1;
+    new->pooled = 0;
+    return new;
+}
+
+int growPool(NodePool* pool) {
+    size_t size = pool->slabSize == 0 ? POOL_MIN_SLAB : pool->slabSize * 2;
+    if (size > POOL_MAX_SLAB) size = POOL_MAX_SLAB;
+
+    NodeSlab* slab = (NodeSlab *)malloc(sizeof(NodeSlab) + size * pool->nodeSize);
+    if (slab == NULL) return 0;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slabSize = size;
+    pool->slabNext = (char *)slab->nodes;
+    pool->slabEnd = pool->slabNext + size * pool->nodeSize;
+    return 1;
+}
+
+//igual que createTreeNode pero toma el nodo del pool del mapa
+TreeNode * allocTreeNode(TreeMap* tree, void* key, void * value) {
+    NodePool* pool = &tree->pool;
+    TreeNode* new;
+
+    if (pool->freeList != NULL) {
+        new = pool->freeList;
+        pool->freeList = new->parent;
+    } else {
+        if (pool->slabNext == pool->slabEnd) {
+            if (!growPool(pool)) return NULL;
+            ADD_STAT(tree, nodeBytes, sizeof(NodeSlab) + pool->slabSize * pool->nodeSize);
+        }
+        new = (TreeNode *)pool->slabNext;
+        pool->slabNext += pool->nodeSize;
+    }
+    COUNT_STAT(tree, allocs);
+    new->pair = &new->entry;
     new->pair->key = key;
     new->pair->value = value;
     new->parent = new->left = new->right = NULL;
+    if (tree->threaded) LINKS(new)->next = LINKS(new)->prev = NULL;
+    new->height = 1;
+    new->size = 1;
+    new->pooled = 1;
+    if (tree->stringKeys) PREFIX(tree, new) = keyPrefix((const char*) key);
     return new;
 }
 
+void freeTreeNode(TreeMap* tree, TreeNode* node) {
+    COUNT_STAT(tree, frees);
+    if (!node->pooled) {
+        free(node);
+        return;
+    }
+    node->parent = tree->pool.freeList;
+    tree->pool.freeList = node;
+}
+
+void spliceSlabs(NodeSlab** into, NodeSlab* list) {
+    if (list == NULL) return;
+    NodeSlab* tail = list;
+    while (tail->next != NULL) tail = tail->next;
+    tail->next = *into;
+    *into = list;
+}
+
+SlabOwner* slabOwner(TreeMap* tree) {
+    SlabOwner* owner = tree->pool.shared;
+    if (owner == NULL) return NULL;
+    while (owner->forward != NULL) owner = owner->forward;
+    tree->pool.shared = owner;
+    return owner;
+}
+
+//desde ahora a y b pueden tener nodos de las slabs del otro
+int shareSlabs(TreeMap* a, TreeMap* b) {
+    SlabOwner* oa = slabOwner(a);
+    SlabOwner* ob = slabOwner(b);
+    if (oa != NULL && oa == ob) return 1;
+    if (oa == NULL && ob == NULL) {
+        oa = (SlabOwner *)calloc(1, sizeof(SlabOwner));
+        if (oa == NULL) return 0;
+        a->pool.shared = oa;
+        oa->refs = 1;
+    }
+    if (oa == NULL) {
+        oa = ob;
+        ob = NULL;
+        TreeMap* aux = a; a = b; b = aux;
+    }
+    if (ob == NULL) {
+        b->pool.shared = oa;
+        oa->refs++;
+        return 1;
+    }
+    spliceSlabs(&oa->slabs, ob->slabs);
+    ob->slabs = NULL;
+    oa->refs += ob->refs;
+    ob->forward = oa;
+    SlabOwner* tail = ob;
+    while (tail->absorbed != NULL) tail = tail->absorbed;
+    tail->absorbed = oa->absorbed;
+    oa->absorbed = ob;
+    return 1;
+}
+
+void freeSlabs(NodeSlab* slab) {
+    while (slab != NULL) {
+        NodeSlab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+}
+
+void releaseSlabs(TreeMap* tree) {
+    SlabOwner* owner = slabOwner(tree);
+    if (owner == NULL) {
+        freeSlabs(tree->pool.slabs);
+        return;
+    }
+    spliceSlabs(&owner->slabs, tree->pool.slabs);
+    if (--owner->refs > 0) return;
+    freeSlabs(owner->slabs);
+    while (owner != NULL) {
+        SlabOwner* next = owner->absorbed;
+        free(owner);
+        owner = next;
+    }
+}
+
+//rotaciones, rebalanceo, recorrido, seleccion y join del AVL: avl_*
+TREEMAP_AVL_INIT(avl, TreeMap, TreeNode)
+
+//funcion del enunciado (ejercicio 4), sobre la version generada
+TreeNode* minimum(TreeNode* x) {
+    return avl_min(x);
+}
+
+//rota x por sobre su padre
+void rotateUp(TreeMap* tree, TreeNode* x) {
+    if (x == x->parent->left) avl_rotate_right(tree, x->parent);
+    else avl_rotate_left(tree, x->parent);
+}
+
+//sube x a la raiz (zig-zig / zig-zag). Cada rotacion recalcula los
+//nodos que mueve, asi que los tamanos del camino quedan al dia aunque
+//estuvieran desactualizados
+void splayNode(TreeMap* tree, TreeNode* x) {
+    while (x->parent != NULL) {
+        TreeNode* p = x->parent;
+        TreeNode* g = p->parent;
+        if (g != NULL && (g->left == p) == (p->left == x)) rotateUp(tree, p);
+        else if (g != NULL) rotateUp(tree, x);
+        rotateUp(tree, x);
+    }
+}
+
+//despues de quitar un hijo de x
+void fixUp(TreeMap* tree, TreeNode* x) {
+    if (!tree->splay) {
+        avl_rebalance(tree, x, -1);
+    } else if (x != NULL) {
+        avl_update(x);
+        splayNode(tree, x);
+    }
+}
+
 TreeMap * createTreeMap(int (*lower_than) (void* key1, void* key2)) {
     TreeMap * map = (TreeMap *)malloc(sizeof(TreeMap));
     if (map == NULL){
@@ -44,204 +406,3228 @@ TreeMap * createTreeMap(int (*lower_than) (void* key1, void* key2)) {
     map->root = NULL;
     map->current = NULL;
     map->lower_than = lower_than;
+    map->compare = NULL;
+    memset(&map->pool, 0, sizeof(NodePool));
+    map->pool.nodeSize = sizeof(TreeNode);
+    map->btree = NULL;
+    map->file = NULL;
+    map->index = NULL;
+    map->stringKeys = 0;
+    map->threaded = 0;
+    map->splay = 0;
+#ifdef TREEMAP_STATS
+    memset(&map->stats, 0, sizeof(TreeMapStats));
+#endif
 
     return map;
 }
 
-void insertTreeMap(TreeMap* tree, void* key, void* value) {
-    if (tree == NULL || key == NULL || value == NULL) {
-        return;
+TreeMap * createTreeMapCompare(int (*compare) (void* key1, void* key2)) {
+    TreeMap * map = createTreeMap(NULL);
+    if (map == NULL) return NULL;
+    map->compare = compare;
+    return map;
+}
+
+int compareStrings(void* key1, void* key2) {
+    return strcmp((const char*) key1, (const char*) key2);
+}
+
+TreeMap * createSplayTreeMap(int (*lower_than) (void* key1, void* key2)) {
+    TreeMap * map = createTreeMap(lower_than);
+    if (map == NULL) return NULL;
+    map->splay = 1;
+    return map;
+}
+
+TreeMap * createSplayTreeMapCompare(int (*compare) (void* key1, void* key2)) {
+    TreeMap * map = createSplayTreeMap(NULL);
+    if (map == NULL) return NULL;
+    map->compare = compare;
+    return map;
+}
+
+TreeMap * createStringTreeMap(void) {
+    TreeMap * map = createTreeMapCompare(compareStrings);
+    if (map == NULL) return NULL;
+    map->stringKeys = 1;
+    map->pool.nodeSize += sizeof(unsigned long long);
+    return map;
+}
+
+/* ---- B+tree: nodos anchos con claves contiguas ---- */
+
+BNode* btreeNewNode(TreeMap* tree, int leaf) {
+    BNode* node;
+    COUNT_STAT(tree, allocs);
+    if (leaf) {
+        BLeaf* l = (BLeaf *)malloc(sizeof(BLeaf));
+        if (l == NULL) return NULL;
+        l->next = l->prev = NULL;
+        node = &l->hdr;
+    } else {
+        BInner* in = (BInner *)malloc(sizeof(BInner));
+        if (in == NULL) return NULL;
+        node = &in->hdr;
     }
+    node->leaf = leaf;
+    node->count = 0;
+    return node;
+}
 
-    TreeNode* newNode = createTreeNode(key, value);
-    if (newNode == NULL) {
-        return;
+void btreeFreeNode(BNode* node) {
+    if (node == NULL) return;
+    if (!node->leaf) {
+        BInner* in = (BInner *)node;
+        for (int i = 0; i <= in->hdr.count; i++) btreeFreeNode(in->children[i]);
     }
+    free(node);
+}
 
-    if (tree->root == NULL) {
-        tree->root = newNode;
-        tree->current = newNode;
-        return;
+//una insercion divide a lo mas la hoja y cada nivel interno, y puede
+//agregar una raiz: esos nodos se reservan antes de tocar el arbol, asi
+//una falta de memoria no deja una division a medias
+int btreeReserve(TreeMap* tree) {
+    BTree* bt = tree->btree;
+    int levels = 0;
+    for (BNode* n = bt->root; n != NULL; n = n->leaf ? NULL : ((BInner *)n)->children[0]) levels++;
+    if (bt->spareLeaf == NULL) {
+        bt->spareLeaf = btreeNewNode(tree, 1);
+        if (bt->spareLeaf == NULL) return 0;
+    }
+    while (bt->spareCount < levels) {
+        BNode* node = btreeNewNode(tree, 0);
+        if (node == NULL) return 0;
+        ((BInner *)node)->children[0] = bt->spare;
+        bt->spare = node;
+        bt->spareCount++;
     }
+    return 1;
+}
 
-    TreeNode* current = tree->root;
-    TreeNode* parent = NULL;
+BNode* btreeTakeNode(BTree* bt, int leaf) {
+    BNode* node;
+    if (leaf) {
+        node = bt->spareLeaf;
+        bt->spareLeaf = NULL;
+    } else {
+        node = bt->spare;
+        bt->spare = ((BInner *)node)->children[0];
+        bt->spareCount--;
+    }
+    return node;
+}
 
-    while (current != NULL) {
-        parent = current;
-        if (tree->lower_than(key, current->pair->key)) {
-            current = current->left;
-        } else if (tree->lower_than(current->pair->key, key)) { 
-            current = current->right;
-        } else {
-            free(newNode->pair);
-            free(newNode);
-            return;
-        }
+void btreeFreeSpare(BTree* bt) {
+    while (bt->spare != NULL) {
+        BNode* next = ((BInner *)bt->spare)->children[0];
+        free(bt->spare);
+        bt->spare = next;
     }
+    free(bt->spareLeaf);
+}
 
-    if (tree->lower_than(key, parent->pair->key)) {
-        parent->left = newNode;
-    } else {
-        parent->right = newNode;
+//pares bajo node
+long btreeCount(BNode* node) {
+    if (node->leaf) return node->count;
+    BInner* in = (BInner *)node;
+    long total = 0;
+    for (int i = 0; i <= in->hdr.count; i++) total += in->counts[i];
+    return total;
+}
+
+//posicion del primer par con clave >= key (> key si strict)
+int btreeLeafFind(TreeMap* tree, BLeaf* leaf, void* key, int strict) {
+    int lo = 0, hi = leaf->hdr.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int before = strict ? !lowerThan(tree, key, leaf->pairs[mid].key)
+                            : lowerThan(tree, leaf->pairs[mid].key, key);
+        if (before) lo = mid + 1;
+        else hi = mid;
     }
+    return lo;
+}
 
-    newNode->parent = parent;
-    tree->current = newNode;
+//hijo por el que se baja: cantidad de separadores <= key
+int btreeChildIndex(TreeMap* tree, BInner* in, void* key) {
+    int lo = 0, hi = in->hdr.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (lowerThan(tree, key, in->keys[mid])) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
 }
 
-TreeNode* minimum(TreeNode* x) {
-    if (x == NULL) {
-        return NULL;
+BLeaf* btreeFindLeaf(TreeMap* tree, void* key) {
+    BNode* node = tree->btree->root;
+    if (node == NULL) return NULL;
+    while (!node->leaf) {
+        BInner* in = (BInner *)node;
+        node = in->children[btreeChildIndex(tree, in, key)];
+    }
+    return (BLeaf *)node;
+}
+
+//retorna el hermano derecho creado si node se dividio (*sep = su menor clave)
+BNode* btreeInsertRec(TreeMap* tree, BNode* node, void* key, void* value, void** sep) {
+    BTree* bt = tree->btree;
+
+    if (node->leaf) {
+        BLeaf* leaf = (BLeaf *)node;
+        int pos = btreeLeafFind(tree, leaf, key, 0);
+        if (pos < leaf->hdr.count && !lowerThan(tree, key, leaf->pairs[pos].key)) {
+            return NULL;
+        }
+
+        BLeaf* target = leaf;
+        BLeaf* right = NULL;
+        if (leaf->hdr.count == BTREE_LEAF_MAX) {
+            right = (BLeaf *)btreeTakeNode(bt, 1);
+            int half = BTREE_LEAF_MAX / 2;
+            right->hdr.count = BTREE_LEAF_MAX - half;
+            memcpy(right->pairs, leaf->pairs + half, right->hdr.count * sizeof(Pair));
+            leaf->hdr.count = half;
+            right->next = leaf->next;
+            if (right->next != NULL) right->next->prev = right;
+            right->prev = leaf;
+            leaf->next = right;
+            if (pos > half) {
+                target = right;
+                pos -= half;
+            }
+        }
+
+        memmove(target->pairs + pos + 1, target->pairs + pos,
+                (target->hdr.count - pos) * sizeof(Pair));
+        target->pairs[pos].key = key;
+        target->pairs[pos].value = value;
+        target->hdr.count++;
+        bt->size++;
+        bt->curLeaf = target;
+        bt->curIndex = pos;
+
+        if (right == NULL) return NULL;
+        *sep = right->pairs[0].key;
+        return &right->hdr;
     }
-    while (x->left != NULL) {
-        x = x->left;
+
+    BInner* in = (BInner *)node;
+    int i = btreeChildIndex(tree, in, key);
+    void* childSep;
+    long before = bt->size;
+    BNode* split = btreeInsertRec(tree, in->children[i], key, value, &childSep);
+    in->counts[i] += bt->size - before;
+    if (split == NULL) return NULL;
+    long splitCount = btreeCount(split);
+    in->counts[i] -= splitCount;
+
+    if (in->hdr.count < BTREE_ORDER - 1) {
+        memmove(in->keys + i + 1, in->keys + i, (in->hdr.count - i) * sizeof(void*));
+        memmove(in->children + i + 2, in->children + i + 1,
+                (in->hdr.count - i) * sizeof(BNode*));
+        memmove(in->counts + i + 2, in->counts + i + 1, (in->hdr.count - i) * sizeof(long));
+        in->keys[i] = childSep;
+        in->children[i + 1] = split;
+        in->counts[i + 1] = splitCount;
+        in->hdr.count++;
+        return NULL;
     }
-    return x;
+
+    //nodo interno lleno: se arma la secuencia completa y se divide al medio
+    void* keys[BTREE_ORDER];
+    BNode* children[BTREE_ORDER + 1];
+    memcpy(keys, in->keys, i * sizeof(void*));
+    keys[i] = childSep;
+    memcpy(keys + i + 1, in->keys + i, (BTREE_ORDER - 1 - i) * sizeof(void*));
+    memcpy(children, in->children, (i + 1) * sizeof(BNode*));
+    children[i + 1] = split;
+    memcpy(children + i + 2, in->children + i + 1, (BTREE_ORDER - 1 - i) * sizeof(BNode*));
+    long counts[BTREE_ORDER + 1];
+    memcpy(counts, in->counts, (i + 1) * sizeof(long));
+    counts[i + 1] = splitCount;
+    memcpy(counts + i + 2, in->counts + i + 1, (BTREE_ORDER - 1 - i) * sizeof(long));
+
+    BInner* right = (BInner *)btreeTakeNode(bt, 0);
+    int mid = BTREE_ORDER / 2;
+    in->hdr.count = mid;
+    memcpy(in->keys, keys, mid * sizeof(void*));
+    memcpy(in->children, children, (mid + 1) * sizeof(BNode*));
+    memcpy(in->counts, counts, (mid + 1) * sizeof(long));
+    right->hdr.count = BTREE_ORDER - 1 - mid;
+    memcpy(right->keys, keys + mid + 1, right->hdr.count * sizeof(void*));
+    memcpy(right->children, children + mid + 1, (right->hdr.count + 1) * sizeof(BNode*));
+    memcpy(right->counts, counts + mid + 1, (right->hdr.count + 1) * sizeof(long));
+    *sep = keys[mid];
+    return &right->hdr;
 }
 
-void removeNode(TreeMap* tree, TreeNode* node) {
-    if (tree == NULL || node == NULL) {
-        return;
+void btreeInsert(TreeMap* tree, void* key, void* value) {
+    BTree* bt = tree->btree;
+    if (bt->root == NULL) {
+        bt->root = btreeNewNode(tree, 1);
+        if (bt->root == NULL) return;
     }
+    if (!btreeReserve(tree)) return;
+    void* sep;
+    BNode* split = btreeInsertRec(tree, bt->root, key, value, &sep);
+    if (split == NULL) return;
 
-    TreeNode* parent = node->parent;
-    TreeNode* child = NULL;
+    BInner* root = (BInner *)btreeTakeNode(bt, 0);
+    root->hdr.count = 1;
+    root->keys[0] = sep;
+    root->children[0] = bt->root;
+    root->children[1] = split;
+    root->counts[1] = btreeCount(split);
+    root->counts[0] = bt->size - root->counts[1];
+    bt->root = &root->hdr;
+}
 
-    if (node->left == NULL || node->right == NULL) {
-        if (node->left == NULL && node->right == NULL) {
-            child = NULL;
-        } else if (node->left != NULL) {
-            child = node->left;
+//repara el hijo i de in cuando quedo con menos del minimo
+void btreeFixChild(TreeMap* tree, BInner* in, int i) {
+    BNode* child = in->children[i];
+    BNode* left = i > 0 ? in->children[i - 1] : NULL;
+    BNode* right = i < in->hdr.count ? in->children[i + 1] : NULL;
+    int min = child->leaf ? BTREE_LEAF_MIN : BTREE_INNER_MIN;
+
+    if (left != NULL && left->count > min) {
+        if (child->leaf) {
+            BLeaf* c = (BLeaf *)child;
+            BLeaf* l = (BLeaf *)left;
+            memmove(c->pairs + 1, c->pairs, c->hdr.count * sizeof(Pair));
+            c->pairs[0] = l->pairs[--l->hdr.count];
+            c->hdr.count++;
+            in->keys[i - 1] = c->pairs[0].key;
         } else {
-            child = node->right;
+            BInner* c = (BInner *)child;
+            BInner* l = (BInner *)left;
+            memmove(c->keys + 1, c->keys, c->hdr.count * sizeof(void*));
+            memmove(c->children + 1, c->children, (c->hdr.count + 1) * sizeof(BNode*));
+            memmove(c->counts + 1, c->counts, (c->hdr.count + 1) * sizeof(long));
+            c->keys[0] = in->keys[i - 1];
+            c->children[0] = l->children[l->hdr.count];
+            c->counts[0] = l->counts[l->hdr.count];
+            c->hdr.count++;
+            in->keys[i - 1] = l->keys[--l->hdr.count];
         }
+        in->counts[i - 1] = btreeCount(left);
+        in->counts[i] = btreeCount(child);
+        return;
+    }
 
-        if (parent != NULL) {
-            if (parent->left == node) {
-                parent->left = child;
-            } else {
-                parent->right = child;
-            }
-            if (child != NULL) {
-                child->parent = parent;
-            }
+    if (right != NULL && right->count > min) {
+        if (child->leaf) {
+            BLeaf* c = (BLeaf *)child;
+            BLeaf* r = (BLeaf *)right;
+            c->pairs[c->hdr.count++] = r->pairs[0];
+            memmove(r->pairs, r->pairs + 1, --r->hdr.count * sizeof(Pair));
+            in->keys[i] = r->pairs[0].key;
         } else {
-            tree->root = child;
-            if (child != NULL) {
-                child->parent = NULL;
-            }
+            BInner* c = (BInner *)child;
+            BInner* r = (BInner *)right;
+            c->keys[c->hdr.count] = in->keys[i];
+            c->counts[c->hdr.count + 1] = r->counts[0];
+            c->children[++c->hdr.count] = r->children[0];
+            in->keys[i] = r->keys[0];
+            memmove(r->keys, r->keys + 1, (r->hdr.count - 1) * sizeof(void*));
+            memmove(r->children, r->children + 1, r->hdr.count * sizeof(BNode*));
+            memmove(r->counts, r->counts + 1, r->hdr.count * sizeof(long));
+            r->hdr.count--;
         }
-        free(node->pair);
-        free(node);
+        in->counts[i] = btreeCount(child);
+        in->counts[i + 1] = btreeCount(right);
+        return;
+    }
+
+    //ningun hermano puede prestar: se fusiona con uno de ellos
+    int j = left != NULL ? i - 1 : i;
+    BNode* a = in->children[j];
+    BNode* b = in->children[j + 1];
+    if (a->leaf) {
+        BLeaf* la = (BLeaf *)a;
+        BLeaf* lb = (BLeaf *)b;
+        memcpy(la->pairs + la->hdr.count, lb->pairs, lb->hdr.count * sizeof(Pair));
+        la->hdr.count += lb->hdr.count;
+        la->next = lb->next;
+        if (la->next != NULL) la->next->prev = la;
     } else {
-        TreeNode* minRight = minimum(node->right);
-        node->pair->key = minRight->pair->key;
-        node->pair->value = minRight->pair->value;
-        removeNode(tree, minRight);
+        BInner* ia = (BInner *)a;
+        BInner* ib = (BInner *)b;
+        ia->keys[ia->hdr.count] = in->keys[j];
+        memcpy(ia->keys + ia->hdr.count + 1, ib->keys, ib->hdr.count * sizeof(void*));
+        memcpy(ia->children + ia->hdr.count + 1, ib->children,
+               (ib->hdr.count + 1) * sizeof(BNode*));
+        memcpy(ia->counts + ia->hdr.count + 1, ib->counts, (ib->hdr.count + 1) * sizeof(long));
+        ia->hdr.count += ib->hdr.count + 1;
     }
+    in->counts[j] += in->counts[j + 1];
+    free(b);
+    COUNT_STAT(tree, frees);
+    memmove(in->keys + j, in->keys + j + 1, (in->hdr.count - j - 1) * sizeof(void*));
+    memmove(in->children + j + 1, in->children + j + 2,
+            (in->hdr.count - j - 1) * sizeof(BNode*));
+    memmove(in->counts + j + 1, in->counts + j + 2, (in->hdr.count - j - 1) * sizeof(long));
+    in->hdr.count--;
 }
 
+//sepSlot apunta al separador del ancestro mas cercano que es igual a la
+//menor clave de esta hoja; se actualiza si se elimina esa clave
+int btreeEraseRec(TreeMap* tree, BNode* node, void* key, void** sepSlot) {
+    if (node->leaf) {
+        BLeaf* leaf = (BLeaf *)node;
+        int pos = btreeLeafFind(tree, leaf, key, 0);
+        if (pos == leaf->hdr.count || lowerThan(tree, key, leaf->pairs[pos].key)) return 0;
+        memmove(leaf->pairs + pos, leaf->pairs + pos + 1,
+                (leaf->hdr.count - pos - 1) * sizeof(Pair));
+        leaf->hdr.count--;
+        if (pos == 0 && sepSlot != NULL && leaf->hdr.count > 0) {
+            *sepSlot = leaf->pairs[0].key;
+        }
+        return 1;
+    }
 
+    BInner* in = (BInner *)node;
+    int i = btreeChildIndex(tree, in, key);
+    if (i > 0) sepSlot = &in->keys[i - 1];
+    if (!btreeEraseRec(tree, in->children[i], key, sepSlot)) return 0;
+    in->counts[i]--;
 
-void eraseTreeMap(TreeMap * tree, void* key){
-    if (tree == NULL || tree->root == NULL) return;
+    int min = in->children[i]->leaf ? BTREE_LEAF_MIN : BTREE_INNER_MIN;
+    if (in->children[i]->count < min) btreeFixChild(tree, in, i);
+    return 1;
+}
 
-    if (searchTreeMap(tree, key) == NULL) return;
-    TreeNode* node = tree->current;
-    removeNode(tree, node);
+void btreeErase(TreeMap* tree, void* key) {
+    BTree* bt = tree->btree;
+    if (bt->root == NULL) return;
+    if (!btreeEraseRec(tree, bt->root, key, NULL)) return;
+    bt->size--;
+    bt->curLeaf = NULL;
+
+    BNode* root = bt->root;
+    if (root->leaf && root->count == 0) {
+        free(root);
+        COUNT_STAT(tree, frees);
+        bt->root = NULL;
+    } else if (!root->leaf && root->count == 0) {
+        bt->root = ((BInner *)root)->children[0];
+        free(root);
+        COUNT_STAT(tree, frees);
+    }
+}
 
+//ubica el primer par con clave >= key (> key si strict); retorna su Pair
+Pair* btreeLocate(TreeMap* tree, void* key, int strict, BLeaf** leafOut, int* indexOut) {
+    BLeaf* leaf = btreeFindLeaf(tree, key);
+    if (leaf == NULL) return NULL;
+    int pos = btreeLeafFind(tree, leaf, key, strict);
+    if (pos == leaf->hdr.count) {
+        leaf = leaf->next;
+        pos = 0;
+    }
+    *leafOut = leaf;
+    *indexOut = pos;
+    return leaf == NULL ? NULL : &leaf->pairs[pos];
 }
 
-Pair* searchTreeMap(TreeMap* tree, void* key) {
-    TreeNode* currentNode = tree->root;
+Pair* btreeSearch(TreeMap* tree, void* key) {
+    BLeaf* leaf;
+    int pos;
+    Pair* p = btreeLocate(tree, key, 0, &leaf, &pos);
+    if (p == NULL || lowerThan(tree, key, p->key)) {
+        tree->btree->curLeaf = NULL;
+        return NULL;
+    }
+    tree->btree->curLeaf = leaf;
+    tree->btree->curIndex = pos;
+    return p;
+}
 
-    while (currentNode != NULL) {
-        int equal = is_equal(tree, key, currentNode->pair->key);
+//cotas: menor clave >= / > key, o mayor clave <= / < key
+Pair* btreeBound(TreeMap* tree, void* key, int floor, int strict) {
+    BLeaf* leaf;
+    int pos;
+    if (!floor) return btreeLocate(tree, key, strict, &leaf, &pos);
 
-        if (equal) {
-            tree->current = currentNode;
-            return currentNode->pair;
-        } else if (tree->lower_than(key, currentNode->pair->key) > 0) {
-            currentNode = currentNode->left;
-        } else {
-            currentNode = currentNode->right;
-        }
+    Pair* p = btreeLocate(tree, key, !strict, &leaf, &pos);
+    if (p == NULL && tree->btree->root == NULL) return NULL;
+    if (p == NULL) {
+        BNode* node = tree->btree->root;
+        while (!node->leaf) node = ((BInner *)node)->children[node->count];
+        leaf = (BLeaf *)node;
+        pos = leaf->hdr.count;
     }
-    tree->current = NULL;
-    return NULL;
+    if (pos == 0) {
+        leaf = leaf->prev;
+        if (leaf == NULL) return NULL;
+        pos = leaf->hdr.count;
+    }
+    return &leaf->pairs[pos - 1];
 }
 
-Pair* upperBound(TreeMap* tree, void* key) {
-    if (tree == NULL || tree->root == NULL) {
+Pair* btreeFirst(TreeMap* tree) {
+    BTree* bt = tree->btree;
+    BNode* node = bt->root;
+    if (node == NULL) {
+        bt->curLeaf = NULL;
         return NULL;
     }
+    while (!node->leaf) node = ((BInner *)node)->children[0];
+    bt->curLeaf = (BLeaf *)node;
+    bt->curIndex = 0;
+    return &bt->curLeaf->pairs[0];
+}
 
-    TreeNode* current = tree->root;
-    Pair* ub_pair = NULL;
-
-    while (current != NULL) {
-        if (tree->lower_than(key, current->pair->key)) {
-            if (ub_pair == NULL || tree->lower_than(current->pair->key, ub_pair->key)) {
-                ub_pair = current->pair;
-            }
-            current = current->left;
-        } else if (tree->lower_than(current->pair->key, key)) {
-            current = current->right;
-        } else {
-            Pair* result = (Pair*)malloc(sizeof(Pair));
-            if (result != NULL) {
-                result->key = current->pair->key;
-                result->value = current->pair->value;
-            }
-            return result;
-        }
+Pair* btreeNext(TreeMap* tree) {
+    BTree* bt = tree->btree;
+    if (bt->curLeaf == NULL) return NULL;
+    if (++bt->curIndex == bt->curLeaf->hdr.count) {
+        bt->curLeaf = bt->curLeaf->next;
+        bt->curIndex = 0;
+        if (bt->curLeaf == NULL) return NULL;
     }
+    return &bt->curLeaf->pairs[bt->curIndex];
+}
 
-    if (ub_pair != NULL) {
-        Pair* result = (Pair*)malloc(sizeof(Pair));
-        if (result != NULL) {
-            result->key = ub_pair->key;
-            result->value = ub_pair->value;
-        }
-        return result;
+Pair* btreeLast(TreeMap* tree) {
+    BTree* bt = tree->btree;
+    BNode* node = bt->root;
+    if (node == NULL) {
+        bt->curLeaf = NULL;
+        return NULL;
     }
+    while (!node->leaf) node = ((BInner *)node)->children[node->count];
+    bt->curLeaf = (BLeaf *)node;
+    bt->curIndex = node->count - 1;
+    return &bt->curLeaf->pairs[bt->curIndex];
+}
 
-    return NULL;
+Pair* btreePrev(TreeMap* tree) {
+    BTree* bt = tree->btree;
+    if (bt->curLeaf == NULL) return NULL;
+    if (bt->curIndex-- == 0) {
+        bt->curLeaf = bt->curLeaf->prev;
+        if (bt->curLeaf == NULL) return NULL;
+        bt->curIndex = bt->curLeaf->hdr.count - 1;
+    }
+    return &bt->curLeaf->pairs[bt->curIndex];
 }
 
+//cantidad de claves < key: suma los conteos de los hijos que quedan a la
+//izquierda del camino
+long btreeRank(TreeMap* tree, void* key) {
+    BNode* node = tree->btree->root;
+    if (node == NULL) return 0;
+    long rank = 0;
+    while (!node->leaf) {
+        BInner* in = (BInner *)node;
+        int i = btreeChildIndex(tree, in, key);
+        for (int j = 0; j < i; j++) rank += in->counts[j];
+        node = in->children[i];
+    }
+    return rank + btreeLeafFind(tree, (BLeaf *)node, key, 0);
+}
 
-Pair* firstTreeMap(TreeMap* tree) {
-    if (tree == NULL || tree->root == NULL) {
-        return NULL; 
+Pair* btreeSelect(TreeMap* tree, long k) {
+    BTree* bt = tree->btree;
+    BNode* node = bt->root;
+    while (!node->leaf) {
+        BInner* in = (BInner *)node;
+        int i = 0;
+        while (k >= in->counts[i]) k -= in->counts[i++];
+        node = in->children[i];
     }
-    TreeNode* minNode = minimum(tree->root);
-    tree->current = minNode;
+    bt->curLeaf = (BLeaf *)node;
+    bt->curIndex = (int)k;
+    return &bt->curLeaf->pairs[k];
+}
 
-    if (minNode != NULL) {
-        return minNode->pair;
-    } else {
+TreeMap * createBTreeMap(int (*lower_than) (void* key1, void* key2)) {
+    TreeMap * map = createTreeMap(lower_than);
+    if (map == NULL) return NULL;
+    map->btree = (BTree *)calloc(1, sizeof(BTree));
+    if (map->btree == NULL) {
+        free(map);
         return NULL;
     }
+    return map;
 }
-Pair* nextTreeMap(TreeMap* tree) {
-    if (tree == NULL || tree->current == NULL) {
-        return NULL; 
+
+TreeMap * createBTreeMapCompare(int (*compare) (void* key1, void* key2)) {
+    TreeMap * map = createBTreeMap(NULL);
+    if (map == NULL) return NULL;
+    map->compare = compare;
+    return map;
+}
+
+/* ---- mapas de solo lectura guardados en un archivo ---- */
+
+Pair* flatPair(FlatMap* f, long i) {
+    if (i < 0 || i >= f->count) return NULL;
+    return &f->index[i];
+}
+
+//posicion de la primera clave >= key (> key si strict)
+long flatFind(TreeMap* tree, void* key, int strict) {
+    FlatMap* f = tree->file;
+    long lo = 0, hi = f->count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        void* k = f->index[mid].key;
+        int before = strict ? !lowerThan(tree, key, k) : lowerThan(tree, k, key);
+        if (before) lo = mid + 1;
+        else hi = mid;
     }
-    if (tree->current->right != NULL) {
-        tree->current = minimum(tree->current->right);
-        return tree->current->pair;
+    return lo;
+}
+
+Pair* flatSearch(TreeMap* tree, void* key, int setCurrent) {
+    FlatMap* f = tree->file;
+    long pos = flatFind(tree, key, 0);
+    if (pos == f->count || lowerThan(tree, key, f->index[pos].key)) pos = -1;
+    if (setCurrent) f->cur = pos;
+    return flatPair(f, pos);
+}
+
+Pair* flatCurrent(FlatMap* f, long pos) {
+    f->cur = pos < f->count ? pos : -1;
+    return flatPair(f, f->cur);
+}
+
+//escribe obj codificado en la posicion *offset (alineada a 8) y retorna
+//esa posicion marcada como offset; 0 si falla
+uint64_t flatWrite(FILE* out, size_t (*encode) (void* obj, void* buf, size_t cap),
+                   void* obj, char** buf, size_t* cap, uint64_t* offset) {
+    size_t len = encode(obj, *buf, *cap);
+    if (len > *cap) {
+        char* bigger = (char *)realloc(*buf, len);
+        if (bigger == NULL) return 0;
+        *buf = bigger;
+        *cap = len;
+        len = encode(obj, *buf, *cap);
     }
-    TreeNode* parent = tree->current->parent;
-    while (parent != NULL && tree->current == parent->right) {
-        tree->current = parent;
-        parent = parent->parent;
+    static const char zeros[8];
+    size_t pad = (8 - len % 8) % 8;
+    if (fwrite(*buf, 1, len, out) != len || fwrite(zeros, 1, pad, out) != pad) return 0;
+    uint64_t start = *offset;
+    *offset += len + pad;
+    return start | 1;
+}
+
+int saveTreeMap(TreeMap* tree, const char* path,
+                size_t (*encodeKey) (void* key, void* buf, size_t cap),
+                size_t (*encodeValue) (void* value, void* buf, size_t cap)) {
+    if (tree == NULL || path == NULL || encodeKey == NULL || encodeValue == NULL) return 0;
+    FlatHeader header;
+    memcpy(header.magic, FLAT_MAGIC, sizeof(header.magic));
+    header.count = sizeTreeMap(tree);
+
+    uint64_t* index = (uint64_t *)malloc((header.count + 1) * 2 * sizeof(uint64_t));
+    size_t cap = 64;
+    char* buf = (char *)malloc(cap);
+    FILE* out = fopen(path, "wb");
+    int ok = index != NULL && buf != NULL && out != NULL;
+
+    //los datos van despues del indice; el indice se escribe al final
+    uint64_t offset = sizeof(FlatHeader) + header.count * 2 * sizeof(uint64_t);
+    ok = ok && fseek(out, (long) offset, SEEK_SET) == 0;
+    TreeCursor cursor;
+    long i = 0;
+    for (Pair* p = ok ? firstCursor(&cursor, tree) : NULL; p != NULL && ok; p = nextCursor(&cursor), i++) {
+        index[2 * i] = flatWrite(out, encodeKey, p->key, &buf, &cap, &offset);
+        index[2 * i + 1] = flatWrite(out, encodeValue, p->value, &buf, &cap, &offset);
+        ok = index[2 * i] != 0 && index[2 * i + 1] != 0;
     }
-    tree->current = parent;
+    ok = ok && fseek(out, 0, SEEK_SET) == 0
+            && fwrite(&header, sizeof(header), 1, out) == 1
+            && fwrite(index, 2 * sizeof(uint64_t), header.count, out) == header.count;
 
-    if (parent != NULL) {
-        return parent->pair;
-    } else {
+    if (out != NULL && fclose(out) != 0) ok = 0;
+    if (!ok && out != NULL) remove(path);
+    free(index);
+    free(buf);
+    return ok;
+}
+
+//un offset valido esta marcado y cae dentro de los datos del archivo
+int flatOffsetOk(uint64_t raw, uint64_t dataStart, size_t length) {
+    uint64_t offset = raw & ~(uint64_t) 1;
+    return (raw & 1) && offset >= dataStart && offset < length;
+}
+
+//cambia los offsets del indice por punteros al mapeo, en un arreglo
+//aparte: asi nunca se escribe en el archivo y las lecturas no modifican
+//nada. Retorna NULL si algun offset no apunta a los datos del archivo
+Pair* flatResolve(char* base, size_t length, long count) {
+    const uint64_t* raw = (const uint64_t *)(base + sizeof(FlatHeader));
+    uint64_t dataStart = sizeof(FlatHeader) + (uint64_t) count * 2 * sizeof(uint64_t);
+    Pair* index = (Pair *)malloc((count + 1) * sizeof(Pair));
+    if (index == NULL) return NULL;
+    for (long i = 0; i < count; i++) {
+        uint64_t key = raw[2 * i], value = raw[2 * i + 1];
+        if (!flatOffsetOk(key, dataStart, length) || !flatOffsetOk(value, dataStart, length)) {
+            free(index);
+            return NULL;
+        }
+        index[i].key = base + (key & ~(uint64_t) 1);
+        index[i].value = base + (value & ~(uint64_t) 1);
+    }
+    return index;
+}
+
+TreeMap * openTreeMap(const char* path, int (*lower_than) (void* key1, void* key2)) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(FlatHeader)) {
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    FlatHeader* header = (FlatHeader *)base;
+    size_t length = st.st_size;
+    TreeMap* map = NULL;
+    FlatMap* f = NULL;
+    Pair* index = NULL;
+    if (memcmp(header->magic, FLAT_MAGIC, sizeof(header->magic)) == 0 &&
+        header->count <= (length - sizeof(FlatHeader)) / (2 * sizeof(uint64_t))) {
+        index = flatResolve((char *)base, length, (long) header->count);
+    }
+    if (index != NULL) {
+        map = createTreeMap(lower_than);
+        f = (FlatMap *)malloc(sizeof(FlatMap));
+    }
+    if (map == NULL || f == NULL) {
+        free(map);
+        free(f);
+        free(index);
+        munmap(base, length);
         return NULL;
     }
+    f->base = (char *)base;
+    f->length = length;
+    f->count = (long) header->count;
+    f->index = index;
+    f->cur = -1;
+    map->file = f;
+    return map;
+}
+
+TreeMap * openTreeMapCompare(const char* path, int (*compare) (void* key1, void* key2)) {
+    TreeMap * map = openTreeMap(path, NULL);
+    if (map == NULL) return NULL;
+    map->compare = compare;
+    return map;
+}
+
+/* ---- indice hash opcional: clave -> nodo ---- */
+
+//hashing de Fibonacci: toma los bits altos, asi un hash debil (por
+//ejemplo el mismo entero) igual se reparte
+size_t hashSlot(unsigned long hash, int bits) {
+    return (size_t) (((unsigned long long) hash * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+void hashPut(HashIndex* ix, unsigned long hash, TreeNode* node) {
+    size_t mask = ((size_t) 1 << ix->bits) - 1;
+    size_t i = hashSlot(hash, ix->bits);
+    while (ix->slots[i].node != NULL) i = (i + 1) & mask;
+    ix->slots[i].hash = hash;
+    ix->slots[i].node = node;
+    ix->count++;
+}
+
+//deja espacio para n nodos con factor de carga <= 1/2
+int hashReserve(HashIndex* ix, long n) {
+    int bits = ix->bits;
+    while ((1L << bits) < 2 * n) bits++;
+    if (bits == ix->bits && ix->slots != NULL) return 1;
+    HashSlot* slots = (HashSlot *)calloc((size_t) 1 << bits, sizeof(HashSlot));
+    if (slots == NULL) return 0;
+    HashSlot* old = ix->slots;
+    size_t oldSize = old == NULL ? 0 : (size_t) 1 << ix->bits;
+    ix->slots = slots;
+    ix->bits = bits;
+    ix->count = 0;
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i].node != NULL) hashPut(ix, old[i].hash, old[i].node);
+    }
+    free(old);
+    return 1;
+}
+
+void dropIndex(TreeMap* tree) {
+    if (tree->index == NULL) return;
+    free(tree->index->slots);
+    free(tree->index);
+    tree->index = NULL;
+}
+
+void indexAdd(TreeMap* tree, TreeNode* node) {
+    HashIndex* ix = tree->index;
+    if (ix == NULL) return;
+    //sin memoria para crecer el mapa sigue sin indice
+    if (!hashReserve(ix, ix->count + 1)) {
+        dropIndex(tree);
+        return;
+    }
+    hashPut(ix, ix->hash(node->pair->key), node);
+}
+
+//borrado con corrimiento hacia atras: no quedan marcas de borrado
+void indexRemove(TreeMap* tree, TreeNode* node) {
+    HashIndex* ix = tree->index;
+    if (ix == NULL) return;
+    size_t mask = ((size_t) 1 << ix->bits) - 1;
+    size_t i = hashSlot(ix->hash(node->pair->key), ix->bits);
+    while (ix->slots[i].node != node) {
+        if (ix->slots[i].node == NULL) return;
+        i = (i + 1) & mask;
+    }
+    for (size_t j = (i + 1) & mask; ix->slots[j].node != NULL; j = (j + 1) & mask) {
+        //j puede pasar al hueco i si su casilla de origen no esta en (i, j]
+        size_t home = hashSlot(ix->slots[j].hash, ix->bits);
+        int between = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!between) {
+            ix->slots[i] = ix->slots[j];
+            i = j;
+        }
+    }
+    ix->slots[i].node = NULL;
+    ix->count--;
+}
+
+TreeNode* indexFind(TreeMap* tree, void* key) {
+    HashIndex* ix = tree->index;
+    size_t mask = ((size_t) 1 << ix->bits) - 1;
+    unsigned long hash = ix->hash(key);
+    for (size_t i = hashSlot(hash, ix->bits); ix->slots[i].node != NULL; i = (i + 1) & mask) {
+        TreeNode* node = ix->slots[i].node;
+        if (ix->slots[i].hash == hash && is_equal(tree, key, node->pair->key)) return node;
+    }
+    return NULL;
+}
+
+//vuelve a indexar todos los nodos (despues de mover nodos entre mapas)
+void reindex(TreeMap* tree) {
+    HashIndex* ix = tree->index;
+    if (ix == NULL) return;
+    if (!hashReserve(ix, avl_count(tree->root))) {
+        dropIndex(tree);
+        return;
+    }
+    memset(ix->slots, 0, ((size_t) 1 << ix->bits) * sizeof(HashSlot));
+    ix->count = 0;
+    for (TreeNode* x = avl_min(tree->root); x != NULL; x = avl_next(x)) {
+        hashPut(ix, ix->hash(x->pair->key), x);
+    }
+}
+
+int indexTreeMap(TreeMap* tree, unsigned long (*hash) (void* key)) {
+    if (tree == NULL || hash == NULL || tree->btree != NULL || tree->file != NULL) return 0;
+    dropIndex(tree);
+    tree->index = (HashIndex *)calloc(1, sizeof(HashIndex));
+    if (tree->index == NULL) return 0;
+    tree->index->hash = hash;
+    tree->index->bits = 4;
+    reindex(tree);
+    return tree->index != NULL;
+}
+
+//sin recursion (un mapa splay puede ser tan profundo como n): rota los
+//hijos izquierdos hacia la derecha y libera bajando por la derecha
+void freeSubtree(TreeMap* tree, TreeNode* node) {
+    while (node != NULL) {
+        TreeNode* left = node->left;
+        if (left != NULL) {
+            node->left = left->right;
+            left->right = node;
+            node = left;
+            continue;
+        }
+        TreeNode* right = node->right;
+        if (!node->pooled) free(node);
+        node = right;
+    }
+}
+
+void destroyTreeMap(TreeMap* tree) {
+    if (tree == NULL) return;
+    freeSubtree(tree, tree->root);
+    dropIndex(tree);
+    if (tree->btree != NULL) {
+        btreeFreeNode(tree->btree->root);
+        btreeFreeSpare(tree->btree);
+        free(tree->btree);
+    }
+    if (tree->file != NULL) {
+        munmap(tree->file->base, tree->file->length);
+        free(tree->file->index);
+        free(tree->file);
+    }
+
+    releaseSlabs(tree);
+    free(tree);
+}
+
+//reserva de una vez un bloque con exactamente n nodos (carga masiva)
+TreeNode * reserveNodes(TreeMap* tree, int n) {
+    NodeSlab* slab = (NodeSlab *)malloc(sizeof(NodeSlab) + (size_t) n * tree->pool.nodeSize);
+    if (slab == NULL) return NULL;
+    slab->next = tree->pool.slabs;
+    tree->pool.slabs = slab;
+    return slab->nodes;
+}
+
+//nodo i de un bloque de reserveNodes (el tamano depende del mapa)
+TreeNode * nodeAt(TreeMap* tree, TreeNode* nodes, long i) {
+    return (TreeNode *)((char *)nodes + i * tree->pool.nodeSize);
+}
+
+//enlaza los nodos lo..hi de un bloque de n nodos en orden
+void threadRange(TreeMap* tree, TreeNode* nodes, long n, long lo, long hi) {
+    for (long i = lo; i <= hi; i++) {
+        TreeNode* x = nodeAt(tree, nodes, i);
+        LINKS(x)->prev = i > 0 ? nodeAt(tree, nodes, i - 1) : NULL;
+        LINKS(x)->next = i + 1 < n ? nodeAt(tree, nodes, i + 1) : NULL;
+    }
+}
+
+TreeNode * buildSubtree(TreeMap* tree, TreeNode* nodes, Pair* pairs, int lo, int hi, TreeNode* parent) {
+    if (lo > hi) return NULL;
+    int mid = lo + (hi - lo) / 2;
+    TreeNode* node = nodeAt(tree, nodes, mid);
+    node->pair = &node->entry;
+    node->entry = pairs[mid];
+    node->parent = parent;
+    node->pooled = 1;
+    if (tree->stringKeys) PREFIX(tree, node) = keyPrefix((const char*) node->entry.key);
+    node->left = buildSubtree(tree, nodes, pairs, lo, mid - 1, node);
+    node->right = buildSubtree(tree, nodes, pairs, mid + 1, hi, node);
+    avl_update(node);
+    return node;
+}
+
+void buildTreeMap(TreeMap* tree, Pair* pairs, int n) {
+    if (tree == NULL || n <= 0 || tree->file != NULL) return;
+    if (tree->btree != NULL || tree->root != NULL) {
+        for (int i = 0; i < n; i++) insertTreeMap(tree, pairs[i].key, pairs[i].value);
+        return;
+    }
+    TreeNode* nodes = reserveNodes(tree, n);
+    if (nodes == NULL) return;
+    ADD_STAT(tree, allocs, n);
+    ADD_STAT(tree, nodeBytes, sizeof(NodeSlab) + (size_t) n * tree->pool.nodeSize);
+    tree->root = buildSubtree(tree, nodes, pairs, 0, n - 1, NULL);
+    tree->current = NULL;
+    reindex(tree);
+    if (tree->threaded) threadRange(tree, nodes, n, 0, n - 1);
+}
+
+//enlaza un nodo nuevo como hijo de parent (o como raiz) y rebalancea
+TreeNode* attachNode(TreeMap* tree, TreeNode* parent, int goLeft, void* key, void* value) {
+    TreeNode* newNode = allocTreeNode(tree, key, value);
+    if (newNode == NULL) {
+        return NULL;
+    }
+
+    tree->current = newNode;
+    indexAdd(tree, newNode);
+    avl_attach(tree, parent, goLeft, newNode);
+    if (parent == NULL) {
+        return newNode;
+    }
+
+    if (tree->threaded) {
+        //un hijo nuevo queda justo antes (izquierdo) o despues de parent
+        ThreadedNode* t = LINKS(newNode);
+        t->prev = goLeft ? LINKS(parent)->prev : parent;
+        t->next = goLeft ? parent : LINKS(parent)->next;
+        if (t->prev != NULL) LINKS(t->prev)->next = newNode;
+        if (t->next != NULL) LINKS(t->next)->prev = newNode;
+    }
+
+    if (tree->splay) splayNode(tree, newNode);
+    else avl_rebalance(tree, parent, 1);
+    return newNode;
+}
+
+//en un mapa splay insertar una clave que ya estaba tambien es un acceso
+TreeNode* existingNode(TreeMap* tree, TreeNode* node) {
+    if (tree->splay) splayNode(tree, node);
+    return node;
+}
+
+//retorna el nodo insertado, o el que ya tenia la clave
+TreeNode* insertNode(TreeMap* tree, void* key, void* value) {
+    TreeNode* current = tree->root;
+    TreeNode* parent = NULL;
+    TreeNode* candidate = NULL; //ultimo nodo con clave <= key
+    int goLeft = 0;
+    unsigned long long prefix = probePrefix(tree, key);
+
+    while (current != NULL) {
+        parent = current;
+        if (tree->compare != NULL) {
+            int c = compareNode(tree, key, prefix, current);
+            if (c == 0) return existingNode(tree, current);
+            goLeft = c < 0;
+        } else {
+            COUNT_STAT(tree, comparisons);
+            goLeft = tree->lower_than(key, current->pair->key);
+            if (!goLeft) candidate = current;
+        }
+        current = goLeft ? current->left : current->right;
+    }
+    if (candidate != NULL && !lowerThan(tree, candidate->pair->key, key)) {
+        return existingNode(tree, candidate);
+    }
+    return attachNode(tree, parent, goLeft, key, value);
+}
+
+void insertTreeMap(TreeMap* tree, void* key, void* value) {
+    if (tree == NULL || key == NULL || value == NULL || tree->file != NULL) {
+        return;
+    }
+    if (tree->btree != NULL) {
+        btreeInsert(tree, key, value);
+        return;
+    }
+    insertNode(tree, key, value);
+}
+
+//en mapas enhebrados los vecinos en orden estan en el nodo: O(1)
+TreeNode* nextNode(TreeMap* tree, TreeNode* x) {
+    return tree->threaded ? LINKS(x)->next : avl_next(x);
+}
+
+TreeNode* prevNode(TreeMap* tree, TreeNode* x) {
+    return tree->threaded ? LINKS(x)->prev : avl_prev(x);
+}
+
+//enlaza en orden los nodos de root; O(n)
+void threadNodes(TreeNode* root) {
+    TreeNode* prev = NULL;
+    for (TreeNode* x = avl_min(root); x != NULL; x = avl_next(x)) {
+        LINKS(x)->prev = prev;
+        if (prev != NULL) LINKS(prev)->next = x;
+        prev = x;
+    }
+    if (prev != NULL) LINKS(prev)->next = NULL;
+}
+
+//los nodos actuales no tienen espacio para los enlaces: se copian en
+//orden a un bloque de nodos enhebrados y se rehacen los punteros. Si
+//ningun otro mapa usa sus slabs, las anteriores se liberan
+void threadTreeMap(TreeMap* tree) {
+    if (tree == NULL || tree->btree != NULL || tree->file != NULL || tree->threaded) return;
+    NodePool* pool = &tree->pool;
+    long n = avl_count(tree->root);
+    NodeSlab* old = pool->slabs;
+    size_t plain = pool->nodeSize;
+    pool->slabs = NULL;
+    pool->nodeSize = plain + sizeof(ThreadedNode) - sizeof(TreeNode);
+    TreeNode* nodes = n > 0 ? reserveNodes(tree, (int) n) : NULL;
+    if (n > 0 && nodes == NULL) {
+        pool->slabs = old;
+        pool->nodeSize = plain;
+        return;
+    }
+
+    //cada nodo original guarda en pair la direccion de su copia y la copia
+    //guarda en next el original, hasta terminar
+    long i = 0;
+    for (TreeNode* x = avl_min(tree->root); x != NULL; x = avl_next(x), i++) {
+        TreeNode* copy = nodeAt(tree, nodes, i);
+        LINKS(copy)->node = *x;
+        LINKS(copy)->next = x;
+        if (tree->stringKeys) {
+            PREFIX(tree, copy) = *(unsigned long long *)((char *)x + plain - sizeof(unsigned long long));
+        }
+        x->pair = (Pair *)copy;
+    }
+    TreeNode* root = tree->root == NULL ? NULL : (TreeNode *)tree->root->pair;
+    TreeNode* current = tree->current == NULL ? NULL : (TreeNode *)tree->current->pair;
+    for (i = 0; i < n; i++) {
+        TreeNode* x = nodeAt(tree, nodes, i);
+        x->pair = &x->entry;
+        x->pooled = 1;
+        if (x->left != NULL) x->left = (TreeNode *)x->left->pair;
+        if (x->right != NULL) x->right = (TreeNode *)x->right->pair;
+        if (x->parent != NULL) x->parent = (TreeNode *)x->parent->pair;
+    }
+    for (i = 0; i < n; i++) {
+        TreeNode* original = LINKS(nodeAt(tree, nodes, i))->next;
+        if (!original->pooled) free(original);
+    }
+    threadRange(tree, nodes, n, 0, n - 1);
+    ADD_STAT(tree, allocs, n);
+    ADD_STAT(tree, frees, n);
+
+    pool->freeList = NULL;
+    pool->slabNext = pool->slabEnd = NULL;
+    if (slabOwner(tree) == NULL) {
+        freeSlabs(old);
+        ADD_STAT(tree, nodeBytes, -tree->stats.nodeBytes);
+    } else {
+        spliceSlabs(&pool->slabs, old);
+    }
+    ADD_STAT(tree, nodeBytes, n > 0 ? sizeof(NodeSlab) + (size_t) n * pool->nodeSize : 0);
+    tree->root = root;
+    tree->current = current;
+    tree->threaded = 1;
+    reindex(tree);
+}
+
+void removeNode(TreeMap* tree, TreeNode* node) {
+    if (tree == NULL || node == NULL) {
+        return;
+    }
+
+    if (node->left == NULL || node->right == NULL) {
+        TreeNode* parent = avl_unlink(tree, node);
+        if (tree->threaded) {
+            ThreadedNode* t = LINKS(node);
+            if (t->prev != NULL) LINKS(t->prev)->next = t->next;
+            if (t->next != NULL) LINKS(t->next)->prev = t->prev;
+        }
+        indexRemove(tree, node);
+        freeTreeNode(tree, node);
+        fixUp(tree, parent);
+    } else {
+        //node se queda con el par de minRight: el indice apunta a node
+        //con la clave nueva y minRight sale al eliminarlo
+        TreeNode* minRight = avl_min(node->right);
+        indexRemove(tree, node);
+        node->pair->key = minRight->pair->key;
+        node->pair->value = minRight->pair->value;
+        if (tree->stringKeys) PREFIX(tree, node) = PREFIX(tree, minRight);
+        indexAdd(tree, node);
+        removeNode(tree, minRight);
+    }
+}
+
+
+
+//nodo con la menor clave >= key (> key si strict)
+TreeNode* ceilingNode(TreeMap* tree, void* key, int strict) {
+    TreeNode* current = tree->root;
+    TreeNode* ub_node = NULL;
+    unsigned long long prefix = probePrefix(tree, key);
+
+    while (current != NULL) {
+        int goLeft;
+        if (tree->stringKeys) {
+            int c = compareNode(tree, key, prefix, current);
+            goLeft = strict ? c < 0 : c <= 0;
+        } else {
+            goLeft = strict ? lowerThan(tree, key, current->pair->key)
+                            : !lowerThan(tree, current->pair->key, key);
+        }
+        if (goLeft) {
+            ub_node = current;
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+    return ub_node;
+}
+
+//nodo con la mayor clave <= key (< key si strict)
+TreeNode* floorNode(TreeMap* tree, void* key, int strict) {
+    TreeNode* current = tree->root;
+    TreeNode* lb_node = NULL;
+    unsigned long long prefix = probePrefix(tree, key);
+
+    while (current != NULL) {
+        int goRight;
+        if (tree->stringKeys) {
+            int c = compareNode(tree, key, prefix, current);
+            goRight = strict ? c > 0 : c >= 0;
+        } else {
+            goRight = strict ? lowerThan(tree, current->pair->key, key)
+                             : !lowerThan(tree, key, current->pair->key);
+        }
+        if (goRight) {
+            lb_node = current;
+            current = current->right;
+        } else {
+            current = current->left;
+        }
+    }
+    return lb_node;
+}
+
+//nodo con clave igual a key; una llamada al comparador por nivel
+TreeNode* findNode(TreeMap* tree, void* key) {
+    if (tree->index != NULL) return indexFind(tree, key);
+    if (tree->compare != NULL) {
+        unsigned long long prefix = probePrefix(tree, key);
+        TreeNode* current = tree->root;
+        while (current != NULL) {
+            int c = compareNode(tree, key, prefix, current);
+            if (c == 0) return current;
+            current = c < 0 ? current->left : current->right;
+        }
+        return NULL;
+    }
+    TreeNode* node = ceilingNode(tree, key, 0);
+    if (node != NULL && !lowerThan(tree, key, node->pair->key)) return node;
+    return NULL;
+}
+
+void eraseTreeMap(TreeMap * tree, void* key){
+    if (tree == NULL || tree->file != NULL) return;
+    if (tree->btree != NULL) {
+        btreeErase(tree, key);
+        return;
+    }
+    if (tree->root == NULL) return;
+
+    if (searchTreeMap(tree, key) == NULL) return;
+    TreeNode* node = tree->current;
+    removeNode(tree, node);
+
+}
+
+Pair* searchTreeMap(TreeMap* tree, void* key) {
+    if (tree->btree != NULL) return btreeSearch(tree, key);
+    if (tree->file != NULL) return flatSearch(tree, key, 1);
+    TreeNode* node = findNode(tree, key);
+    tree->current = node;
+    if (node != NULL && tree->splay) splayNode(tree, node);
+    return node == NULL ? NULL : node->pair;
+}
+
+Pair* upperBound(TreeMap* tree, void* key) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) return btreeBound(tree, key, 0, 0);
+    if (tree->file != NULL) return flatPair(tree->file, flatFind(tree, key, 0));
+    TreeNode* node = ceilingNode(tree, key, 0);
+    return node == NULL ? NULL : node->pair;
+}
+
+Pair* ceilingTreeMap(TreeMap* tree, void* key) {
+    return upperBound(tree, key);
+}
+
+Pair* floorTreeMap(TreeMap* tree, void* key) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) return btreeBound(tree, key, 1, 0);
+    if (tree->file != NULL) return flatPair(tree->file, flatFind(tree, key, 1) - 1);
+    TreeNode* node = floorNode(tree, key, 0);
+    return node == NULL ? NULL : node->pair;
+}
+
+Pair* higherTreeMap(TreeMap* tree, void* key) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) return btreeBound(tree, key, 0, 1);
+    if (tree->file != NULL) return flatPair(tree->file, flatFind(tree, key, 1));
+    TreeNode* node = ceilingNode(tree, key, 1);
+    return node == NULL ? NULL : node->pair;
+}
+
+Pair* lowerTreeMap(TreeMap* tree, void* key) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) return btreeBound(tree, key, 1, 1);
+    if (tree->file != NULL) return flatPair(tree->file, flatFind(tree, key, 0) - 1);
+    TreeNode* node = floorNode(tree, key, 1);
+    return node == NULL ? NULL : node->pair;
+}
+
+
+Pair* firstTreeMap(TreeMap* tree) {
+    if (tree != NULL && tree->btree != NULL) return btreeFirst(tree);
+    if (tree != NULL && tree->file != NULL) return flatCurrent(tree->file, 0);
+    if (tree == NULL || tree->root == NULL) {
+        return NULL; 
+    }
+    TreeNode* minNode = avl_min(tree->root);
+    tree->current = minNode;
+
+    if (minNode != NULL) {
+        return minNode->pair;
+    } else {
+        return NULL;
+    }
+}
+Pair* nextTreeMap(TreeMap* tree) {
+    if (tree != NULL && tree->btree != NULL) return btreeNext(tree);
+    if (tree != NULL && tree->file != NULL) {
+        FlatMap* f = tree->file;
+        return f->cur < 0 ? NULL : flatCurrent(f, f->cur + 1);
+    }
+    if (tree == NULL || tree->current == NULL) {
+        return NULL; 
+    }
+    tree->current = nextNode(tree, tree->current);
+
+    if (tree->current != NULL) {
+        return tree->current->pair;
+    } else {
+        return NULL;
+    }
+}
+
+Pair* lastTreeMap(TreeMap* tree) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) return btreeLast(tree);
+    if (tree->file != NULL) return flatCurrent(tree->file, tree->file->count - 1);
+    tree->current = avl_max(tree->root);
+    return tree->current == NULL ? NULL : tree->current->pair;
+}
+
+Pair* prevTreeMap(TreeMap* tree) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) return btreePrev(tree);
+    if (tree->file != NULL) {
+        FlatMap* f = tree->file;
+        return f->cur < 0 ? NULL : flatCurrent(f, f->cur - 1);
+    }
+    if (tree->current == NULL) return NULL;
+    tree->current = prevNode(tree, tree->current);
+    return tree->current == NULL ? NULL : tree->current->pair;
+}
+
+//busqueda de solo lectura: no modifica current
+Pair* lookupTreeMap(TreeMap* tree, void* key) {
+    if (tree == NULL) return NULL;
+    if (tree->btree != NULL) {
+        BLeaf* leaf;
+        int pos;
+        Pair* p = btreeLocate(tree, key, 0, &leaf, &pos);
+        if (p == NULL || lowerThan(tree, key, p->key)) return NULL;
+        return p;
+    }
+    if (tree->file != NULL) return flatSearch(tree, key, 0);
+    TreeNode* node = findNode(tree, key);
+    return node == NULL ? NULL : node->pair;
+}
+
+/* ---- cursores: el estado de la iteracion pertenece al llamador ---- */
+
+Pair* cursorPair(TreeCursor* cursor) {
+    if (cursor->node == NULL) return NULL;
+    if (cursor->tree->btree != NULL) {
+        return &((BLeaf *)cursor->node)->pairs[cursor->index];
+    }
+    if (cursor->tree->file != NULL) return flatPair(cursor->tree->file, cursor->index);
+    return ((TreeNode *)cursor->node)->pair;
+}
+
+Pair* firstCursor(TreeCursor* cursor, TreeMap* tree) {
+    cursor->tree = tree;
+    cursor->index = 0;
+    if (tree->btree != NULL) {
+        BNode* node = tree->btree->root;
+        while (node != NULL && !node->leaf) node = ((BInner *)node)->children[0];
+        cursor->node = node;
+    } else if (tree->file != NULL) {
+        cursor->node = tree->file->count > 0 ? tree->file : NULL;
+    } else {
+        cursor->node = avl_min(tree->root);
+    }
+    return cursorPair(cursor);
+}
+
+Pair* lastCursor(TreeCursor* cursor, TreeMap* tree) {
+    cursor->tree = tree;
+    cursor->index = 0;
+    if (tree->btree != NULL) {
+        BNode* node = tree->btree->root;
+        while (node != NULL && !node->leaf) node = ((BInner *)node)->children[node->count];
+        cursor->node = node;
+        if (node != NULL) cursor->index = node->count - 1;
+    } else if (tree->file != NULL) {
+        cursor->index = tree->file->count - 1;
+        cursor->node = cursor->index >= 0 ? tree->file : NULL;
+    } else {
+        cursor->node = avl_max(tree->root);
+    }
+    return cursorPair(cursor);
+}
+
+Pair* seekCursor(TreeCursor* cursor, TreeMap* tree, void* key) {
+    cursor->tree = tree;
+    cursor->index = 0;
+    if (tree->btree != NULL) {
+        BLeaf* leaf = NULL;
+        int pos = 0;
+        btreeLocate(tree, key, 0, &leaf, &pos);
+        cursor->node = leaf;
+        cursor->index = pos;
+    } else if (tree->file != NULL) {
+        cursor->index = flatFind(tree, key, 0);
+        cursor->node = cursor->index < tree->file->count ? tree->file : NULL;
+    } else {
+        cursor->node = ceilingNode(tree, key, 0);
+    }
+    return cursorPair(cursor);
+}
+
+Pair* nextCursor(TreeCursor* cursor) {
+    if (cursor->node == NULL) return NULL;
+    if (cursor->tree->btree != NULL) {
+        BLeaf* leaf = (BLeaf *)cursor->node;
+        if (++cursor->index == leaf->hdr.count) {
+            cursor->node = leaf->next;
+            cursor->index = 0;
+        }
+    } else if (cursor->tree->file != NULL) {
+        if (++cursor->index == cursor->tree->file->count) cursor->node = NULL;
+    } else {
+        cursor->node = nextNode(cursor->tree, (TreeNode *)cursor->node);
+    }
+    return cursorPair(cursor);
+}
+
+Pair* prevCursor(TreeCursor* cursor) {
+    if (cursor->node == NULL) return NULL;
+    if (cursor->tree->btree != NULL) {
+        BLeaf* leaf = (BLeaf *)cursor->node;
+        if (cursor->index-- == 0) {
+            leaf = leaf->prev;
+            cursor->node = leaf;
+            cursor->index = leaf == NULL ? 0 : leaf->hdr.count - 1;
+        }
+    } else if (cursor->tree->file != NULL) {
+        if (cursor->index-- == 0) cursor->node = NULL;
+    } else {
+        cursor->node = prevNode(cursor->tree, (TreeNode *)cursor->node);
+    }
+    return cursorPair(cursor);
+}
+
+/* ---- insercion con pista ---- */
+
+//inserta junto a h si key queda entre h y su vecino; NULL si la pista no
+//sirve. Solo compara con h y el vecino
+TreeNode* insertNear(TreeMap* tree, TreeNode* h, void* key, void* value) {
+    int c = compareKeys(tree, key, h->pair->key);
+    if (c == 0) return existingNode(tree, h);
+    if (c > 0) {
+        TreeNode* next = nextNode(tree, h);
+        if (next != NULL) {
+            int d = compareKeys(tree, key, next->pair->key);
+            if (d == 0) return existingNode(tree, next);
+            if (d > 0) return NULL;
+        }
+        //entre h y next: h no tiene hijo derecho o next no tiene izquierdo
+        if (h->right == NULL) return attachNode(tree, h, 0, key, value);
+        return attachNode(tree, next, 1, key, value);
+    }
+    TreeNode* prev = prevNode(tree, h);
+    if (prev != NULL) {
+        int d = compareKeys(tree, key, prev->pair->key);
+        if (d == 0) return existingNode(tree, prev);
+        if (d < 0) return NULL;
+    }
+    if (h->left == NULL) return attachNode(tree, h, 1, key, value);
+    return attachNode(tree, prev, 0, key, value);
+}
+
+Pair* insertHintTreeMap(TreeMap* tree, TreeCursor* hint, void* key, void* value) {
+    if (tree == NULL || key == NULL || value == NULL || tree->file != NULL) return NULL;
+    TreeCursor local = { NULL, NULL, 0 };
+    if (hint == NULL) hint = &local;
+    if (tree->btree != NULL) {
+        btreeInsert(tree, key, value);
+        return seekCursor(hint, tree, key);
+    }
+
+    TreeNode* node = NULL;
+    if (hint->tree == tree && hint->node != NULL) {
+        node = insertNear(tree, (TreeNode *)hint->node, key, value);
+    }
+    if (node == NULL) node = insertNode(tree, key, value);
+    hint->tree = tree;
+    hint->node = node;
+    hint->index = 0;
+    return node == NULL ? NULL : node->pair;
+}
+
+/* ---- estadisticos de orden ---- */
+
+long sizeTreeMap(TreeMap* tree) {
+    if (tree == NULL) return 0;
+    if (tree->btree != NULL) return tree->btree->size;
+    if (tree->file != NULL) return tree->file->count;
+    return avl_count(tree->root);
+}
+
+long rankTreeMap(TreeMap* tree, void* key) {
+    if (tree == NULL) return 0;
+    if (tree->btree != NULL) return btreeRank(tree, key);
+    if (tree->file != NULL) return flatFind(tree, key, 0);
+    long rank = 0;
+    TreeNode* node = tree->root;
+    while (node != NULL) {
+        if (lowerThan(tree, node->pair->key, key)) {
+            rank += avl_count(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return rank;
+}
+
+Pair* selectTreeMap(TreeMap* tree, long k) {
+    if (tree == NULL || k < 0 || k >= sizeTreeMap(tree)) return NULL;
+    if (tree->btree != NULL) return btreeSelect(tree, k);
+    if (tree->file != NULL) return flatCurrent(tree->file, k);
+    TreeNode* node = avl_select(tree->root, k);
+    tree->current = node;
+    return node == NULL ? NULL : node->pair;
+}
+
+/* ---- recorrido por rango [lo, hi) ---- */
+
+typedef struct RangeVisit {
+    TreeMap * tree;
+    void * lo;
+    void * hi;
+    int (*visit) (Pair* pair, void* data);
+    void * data;
+    long count;
+} RangeVisit;
+
+//loOk/hiOk indican que todo el subarbol ya cumple esa cota
+int visitRange(RangeVisit* r, TreeNode* node, int loOk, int hiOk) {
+    while (node != NULL) {
+        int aboveLo = loOk || !lowerThan(r->tree, node->pair->key, r->lo);
+        int belowHi = hiOk || lowerThan(r->tree, node->pair->key, r->hi);
+        if (aboveLo && !visitRange(r, node->left, loOk, belowHi)) return 0;
+        if (aboveLo && belowHi) {
+            r->count++;
+            if (r->visit != NULL && !r->visit(node->pair, r->data)) return 0;
+        }
+        if (!belowHi) return 1;
+        loOk = aboveLo;
+        node = node->right;
+    }
+    return 1;
+}
+
+long rangeTreeMap(TreeMap* tree, void* lo, void* hi,
+                  int (*visit) (Pair* pair, void* data), void* data) {
+    if (tree == NULL) return 0;
+    RangeVisit r = { tree, lo, hi, visit, data, 0 };
+
+    if (tree->btree != NULL || tree->file != NULL || tree->splay) {
+        TreeCursor cursor;
+        Pair* p = lo == NULL ? firstCursor(&cursor, tree) : seekCursor(&cursor, tree, lo);
+        for (; p != NULL; p = nextCursor(&cursor)) {
+            if (hi != NULL && !lowerThan(tree, p->key, hi)) break;
+            r.count++;
+            if (visit != NULL && !visit(p, data)) break;
+        }
+        return r.count;
+    }
+    visitRange(&r, tree->root, lo == NULL, hi == NULL);
+    return r.count;
+}
+
+//parte de la mayor clave < hi y retrocede con un cursor: cada paso es O(1)
+//amortizado, asi que las ultimas N claves cuestan O(log n + N)
+long rangeReverseTreeMap(TreeMap* tree, void* lo, void* hi,
+                         int (*visit) (Pair* pair, void* data), void* data) {
+    if (tree == NULL) return 0;
+    TreeCursor cursor;
+    Pair* p;
+    if (hi == NULL || seekCursor(&cursor, tree, hi) == NULL) p = lastCursor(&cursor, tree);
+    else p = prevCursor(&cursor);
+    long count = 0;
+    for (; p != NULL; p = prevCursor(&cursor)) {
+        if (lo != NULL && lowerThan(tree, p->key, lo)) break;
+        count++;
+        if (visit != NULL && !visit(p, data)) break;
+    }
+    return count;
+}
+
+long countRangeTreeMap(TreeMap* tree, void* lo, void* hi) {
+    if (tree == NULL) return 0;
+    if (tree->file != NULL) {
+        long count = (hi == NULL ? tree->file->count : flatFind(tree, hi, 0))
+                   - (lo == NULL ? 0 : flatFind(tree, lo, 0));
+        return count > 0 ? count : 0;
+    }
+    long count = (hi == NULL ? sizeTreeMap(tree) : rankTreeMap(tree, hi))
+               - (lo == NULL ? 0 : rankTreeMap(tree, lo));
+    return count > 0 ? count : 0;
+}
+
+/* ---- join, split y operaciones de conjuntos ---- */
+
+//divide t en claves < key (*l) y > key (*r); retorna el nodo con key o NULL
+TreeNode* splitNodes(TreeMap* tree, TreeNode* t, void* key, TreeNode** l, TreeNode** r) {
+    if (t == NULL) {
+        *l = *r = NULL;
+        return NULL;
+    }
+    TreeNode* left = t->left;
+    TreeNode* right = t->right;
+    int c = compareKeys(tree, key, t->pair->key);
+    TreeNode* found;
+    if (c == 0) {
+        if (left != NULL) left->parent = NULL;
+        if (right != NULL) right->parent = NULL;
+        *l = left;
+        *r = right;
+        return t;
+    }
+    if (c < 0) {
+        found = splitNodes(tree, left, key, l, r);
+        *r = avl_join(*r, t, right);
+    } else {
+        found = splitNodes(tree, right, key, l, r);
+        *l = avl_join(left, t, *l);
+    }
+    return found;
+}
+
+void dropSubtree(TreeMap* tree, TreeNode* t) {
+    while (t != NULL) {
+        TreeNode* right = t->right;
+        dropSubtree(tree, t->left);
+        freeTreeNode(tree, t);
+        t = right;
+    }
+}
+
+//los dos recursos de cada nivel son independientes (se pueden paralelizar);
+//con m <= n pares el trabajo es O(m log(n/m + 1))
+TreeNode* unionNodes(TreeMap* tree, TreeNode* a, TreeNode* b) {
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    TreeNode *l, *r;
+    TreeNode* dup = splitNodes(tree, b, a->pair->key, &l, &r);
+    if (dup != NULL) freeTreeNode(tree, dup);
+    TreeNode* left = unionNodes(tree, a->left, l);
+    TreeNode* right = unionNodes(tree, a->right, r);
+    return avl_join(left, a, right);
+}
+
+TreeNode* intersectionNodes(TreeMap* tree, TreeNode* a, TreeNode* b) {
+    if (a == NULL || b == NULL) {
+        dropSubtree(tree, a);
+        dropSubtree(tree, b);
+        return NULL;
+    }
+    TreeNode *l, *r;
+    TreeNode* dup = splitNodes(tree, b, a->pair->key, &l, &r);
+    TreeNode* aLeft = a->left;
+    TreeNode* aRight = a->right;
+    TreeNode* left = intersectionNodes(tree, aLeft, l);
+    TreeNode* right = intersectionNodes(tree, aRight, r);
+    if (dup == NULL) {
+        freeTreeNode(tree, a);
+        return avl_join_two(left, right);
+    }
+    freeTreeNode(tree, dup);
+    return avl_join(left, a, right);
+}
+
+//claves de a que no estan en b
+TreeNode* differenceNodes(TreeMap* tree, TreeNode* a, TreeNode* b) {
+    if (a == NULL || b == NULL) {
+        dropSubtree(tree, b);
+        return a;
+    }
+    TreeNode *l, *r;
+    TreeNode* dup = splitNodes(tree, a, b->pair->key, &l, &r);
+    if (dup != NULL) freeTreeNode(tree, dup);
+    TreeNode* bLeft = b->left;
+    TreeNode* bRight = b->right;
+    freeTreeNode(tree, b);
+    TreeNode* left = differenceNodes(tree, l, bLeft);
+    TreeNode* right = differenceNodes(tree, r, bRight);
+    return avl_join_two(left, right);
+}
+
+//solo mapas AVL; los nodos de other pasan a tree
+int canMerge(TreeMap* tree, TreeMap* other) {
+    if (tree == NULL || other == NULL || tree == other) return 0;
+    if (tree->btree != NULL || tree->file != NULL) return 0;
+    if (other->btree != NULL || other->file != NULL) return 0;
+    if (tree->splay || other->splay) return 0; //join necesita las alturas AVL
+    if (tree->stringKeys != other->stringKeys) return 0; //distinto formato de nodo
+    //los nodos que llegan a un mapa enhebrado necesitan espacio para los enlaces
+    if (tree->threaded) threadTreeMap(other);
+    if (tree->threaded && !other->threaded) return 0;
+    return shareSlabs(tree, other);
+}
+
+//con indice hash los nodos que cambiaron de mapa se indexan de nuevo: O(n)
+void setRoot(TreeMap* tree, TreeNode* root) {
+    tree->root = root;
+    if (root != NULL) root->parent = NULL;
+    tree->current = NULL;
+    reindex(tree);
+}
+
+TreeMap * splitTreeMap(TreeMap * tree, void* key) {
+    if (tree == NULL || tree->btree != NULL || tree->file != NULL || tree->splay) return NULL;
+    TreeMap * upper = createTreeMap(tree->lower_than);
+    if (upper == NULL) return NULL;
+    upper->compare = tree->compare;
+    upper->stringKeys = tree->stringKeys;
+    upper->threaded = tree->threaded;
+    upper->pool.nodeSize = tree->pool.nodeSize;
+    if (tree->index != NULL) indexTreeMap(upper, tree->index->hash);
+    if (!shareSlabs(tree, upper)) {
+        destroyTreeMap(upper);
+        return NULL;
+    }
+    TreeNode *l, *r;
+    TreeNode* found = splitNodes(tree, tree->root, key, &l, &r);
+    if (found != NULL) r = avl_join(NULL, found, r);
+    if (tree->threaded && l != NULL && r != NULL) {
+        //l y r eran vecinos: solo se corta ese enlace
+        LINKS(avl_max(l))->next = NULL;
+        LINKS(avl_min(r))->prev = NULL;
+    }
+    setRoot(tree, l);
+    setRoot(upper, r);
+    return upper;
+}
+
+//en mapas enhebrados union, interseccion y diferencia vuelven a enlazar
+//el resultado completo (O(n)); join solo une los extremos
+void setMergedRoot(TreeMap* tree, TreeMap* other, TreeNode* root) {
+    setRoot(tree, root);
+    setRoot(other, NULL);
+    if (tree->threaded) threadNodes(root);
+}
+
+void joinTreeMap(TreeMap * tree, TreeMap * other) {
+    if (!canMerge(tree, other)) return;
+    TreeNode* last = avl_max(tree->root);
+    TreeNode* first = avl_min(other->root);
+    if (last != NULL && first != NULL && !lowerThan(tree, last->pair->key, first->pair->key)) {
+        unionTreeMap(tree, other);
+        return;
+    }
+    setRoot(tree, avl_join_two(tree->root, other->root));
+    setRoot(other, NULL);
+    if (tree->threaded && last != NULL && first != NULL) {
+        LINKS(last)->next = first;
+        LINKS(first)->prev = last;
+    }
+}
+
+void unionTreeMap(TreeMap * tree, TreeMap * other) {
+    if (!canMerge(tree, other)) return;
+    setMergedRoot(tree, other, unionNodes(tree, tree->root, other->root));
+}
+
+void intersectionTreeMap(TreeMap * tree, TreeMap * other) {
+    if (!canMerge(tree, other)) return;
+    setMergedRoot(tree, other, intersectionNodes(tree, tree->root, other->root));
+}
+
+void differenceTreeMap(TreeMap * tree, TreeMap * other) {
+    if (!canMerge(tree, other)) return;
+    setMergedRoot(tree, other, differenceNodes(tree, tree->root, other->root));
+}
+
+/* ---- recorrido y construccion en paralelo ---- */
+
+//un trabajo se divide en piezas numeradas; cada hilo parte con un bloque
+//contiguo de piezas, toma las suyas desde el frente y, cuando se le
+//acaban, roba desde el final del bloque de otro hilo
+typedef struct PoolJob PoolJob;
+
+struct PoolJob {
+    void (*run) (PoolJob* job, long piece);
+    long pieces;
+};
+
+typedef struct PoolQueue {
+    pthread_mutex_t lock;
+    long head, tail;
+} PoolQueue;
+
+struct TreeMapPool {
+    int threads; //incluye al hilo que llama
+    pthread_t * workers;
+    PoolQueue * queues;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    PoolJob * job;
+    long generation;
+    int active; //hilos que no terminan el trabajo actual
+    int stop;
+};
+
+typedef struct PoolWorker {
+    TreeMapPool * pool;
+    int id;
+} PoolWorker;
+
+long poolTake(PoolQueue* q, int steal) {
+    long piece = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) piece = steal ? --q->tail : q->head++;
+    pthread_mutex_unlock(&q->lock);
+    return piece;
+}
+
+void poolWork(TreeMapPool* pool, int id) {
+    PoolJob* job = pool->job;
+    for (;;) {
+        long piece = poolTake(&pool->queues[id], 0);
+        for (int i = 1; piece < 0 && i < pool->threads; i++) {
+            piece = poolTake(&pool->queues[(id + i) % pool->threads], 1);
+        }
+        //las piezas no se crean durante el trabajo: si nadie tiene, termino
+        if (piece < 0) return;
+        job->run(job, piece);
+    }
+}
+
+void* poolWorkerMain(void* arg) {
+    PoolWorker* w = (PoolWorker *)arg;
+    TreeMapPool* pool = w->pool;
+    long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        poolWork(pool, w->id);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    free(w);
+    return NULL;
+}
+
+TreeMapPool * createTreeMapPool(int threads) {
+    if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    TreeMapPool* pool = (TreeMapPool *)calloc(1, sizeof(TreeMapPool));
+    if (pool == NULL) return NULL;
+    pool->queues = (PoolQueue *)calloc(threads, sizeof(PoolQueue));
+    pool->workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    if (pool->queues == NULL || pool->workers == NULL) {
+        free(pool->queues);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < threads; i++) pthread_mutex_init(&pool->queues[i].lock, NULL);
+    //si no se puede crear un hilo el pool queda con los que hay
+    pool->threads = 1;
+    for (int i = 1; i < threads; i++) {
+        PoolWorker* w = (PoolWorker *)malloc(sizeof(PoolWorker));
+        if (w == NULL) break;
+        w->pool = pool;
+        w->id = i;
+        if (pthread_create(&pool->workers[i], NULL, poolWorkerMain, w) != 0) {
+            free(w);
+            break;
+        }
+        pool->threads++;
+    }
+    return pool;
+}
+
+void destroyTreeMapPool(TreeMapPool * pool) {
+    if (pool == NULL) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->threads; i++) pthread_join(pool->workers[i], NULL);
+    for (int i = 0; i < pool->threads; i++) pthread_mutex_destroy(&pool->queues[i].lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool);
+}
+
+//corre todas las piezas de job; sin pool (o con un hilo) en el que llama
+void poolRun(TreeMapPool* pool, PoolJob* job) {
+    if (pool == NULL || pool->threads == 1 || job->pieces <= 1) {
+        for (long i = 0; i < job->pieces; i++) job->run(job, i);
+        return;
+    }
+    int t = pool->threads;
+    for (int i = 0; i < t; i++) {
+        pool->queues[i].head = job->pieces * i / t;
+        pool->queues[i].tail = job->pieces * (i + 1) / t;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->active = t - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    poolWork(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pool->job = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int poolThreads(TreeMapPool* pool) {
+    return pool == NULL ? 1 : pool->threads;
+}
+
+//tamano de pieza: unas 8 por hilo para que el robo reparta la carga
+long poolGrain(TreeMapPool* pool, long n) {
+    long grain = n / (8L * poolThreads(pool));
+    return grain < 1024 ? 1024 : grain;
+}
+
+//tramo contiguo de pares en orden: count pares desde start, el primero
+//en la posicion rank
+typedef struct TreeSpan {
+    TreeCursor start;
+    long count;
+    long rank;
+} TreeSpan;
+
+typedef struct SpanList {
+    TreeSpan * spans;
+    long count, capacity;
+    long total;
+} SpanList;
+
+int addSpan(SpanList* list, TreeMap* tree, void* node, int index, long count) {
+    if (list->count == list->capacity) {
+        long capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        TreeSpan* spans = (TreeSpan *)realloc(list->spans, capacity * sizeof(TreeSpan));
+        if (spans == NULL) return 0;
+        list->spans = spans;
+        list->capacity = capacity;
+    }
+    TreeSpan* s = &list->spans[list->count++];
+    s->start.tree = tree;
+    s->start.node = node;
+    s->start.index = index;
+    s->count = count;
+    s->rank = list->total;
+    list->total += count;
+    return 1;
+}
+
+//cubre el subarbol x con tramos de a lo mas grain pares (mas los nodos
+//que separan subarboles grandes, que se agregan al tramo anterior)
+int spanSubtree(SpanList* list, TreeMap* tree, TreeNode* x, long grain) {
+    while (x != NULL) {
+        if (avl_count(x) <= grain) return addSpan(list, tree, avl_min(x), 0, avl_count(x));
+        if (!spanSubtree(list, tree, x->left, grain)) return 0;
+        if (list->count > 0) {
+            list->spans[list->count - 1].count++;
+            list->total++;
+        } else if (!addSpan(list, tree, x, 0, 1)) {
+            return 0;
+        }
+        x = x->right;
+    }
+    return 1;
+}
+
+//divide el mapa en tramos en orden; O(n / grain) salvo en el B+tree, que
+//recorre sus hojas (O(n / B))
+int spanTreeMap(SpanList* list, TreeMap* tree, long grain) {
+    memset(list, 0, sizeof(SpanList));
+    if (tree->file != NULL) {
+        for (long i = 0; i < tree->file->count; i += grain) {
+            long count = tree->file->count - i < grain ? tree->file->count - i : grain;
+            if (!addSpan(list, tree, tree->file, (int) i, count)) return 0;
+        }
+        return 1;
+    }
+    if (tree->btree != NULL) {
+        TreeCursor c;
+        firstCursor(&c, tree);
+        BLeaf* leaf = (BLeaf *)c.node;
+        while (leaf != NULL) {
+            BLeaf* first = leaf;
+            long count = 0;
+            while (leaf != NULL && count < grain) {
+                count += leaf->hdr.count;
+                leaf = leaf->next;
+            }
+            if (!addSpan(list, tree, first, 0, count)) return 0;
+        }
+        return 1;
+    }
+    if (tree->splay) {
+        //la profundidad no esta acotada: se ubica cada tramo por su posicion
+        for (long i = 0; i < avl_count(tree->root); i += grain) {
+            long count = avl_count(tree->root) - i < grain ? avl_count(tree->root) - i : grain;
+            if (!addSpan(list, tree, avl_select(tree->root, i), 0, count)) return 0;
+        }
+        return 1;
+    }
+    return spanSubtree(list, tree, tree->root, grain);
+}
+
+typedef struct ReduceJob {
+    PoolJob job;
+    TreeSpan * spans;
+    char * accs;
+    size_t accSize;
+    void (*fold) (void* acc, Pair* pair, void* data);
+    void (*visit) (Pair* pair, long rank, void* data);
+    void * data;
+} ReduceJob;
+
+void runSpan(PoolJob* job, long piece) {
+    ReduceJob* r = (ReduceJob *)job;
+    TreeSpan* s = &r->spans[piece];
+    TreeCursor c = s->start;
+    Pair* p = cursorPair(&c);
+    for (long i = 0; i < s->count; i++) {
+        //no se avanza mas alla del tramo: el par siguiente es de otro hilo
+        if (i > 0) p = nextCursor(&c);
+        if (r->fold != NULL) r->fold(r->accs + piece * r->accSize, p, r->data);
+        else r->visit(p, s->rank + i, r->data);
+    }
+}
+
+int reduceTreeMap(TreeMapPool * pool, TreeMap * tree, void* acc, size_t accSize,
+                  void (*fold) (void* acc, Pair* pair, void* data),
+                  void (*combine) (void* acc, void* other, void* data), void* data) {
+    if (tree == NULL || fold == NULL || combine == NULL) return 0;
+    SpanList list;
+    if (!spanTreeMap(&list, tree, poolGrain(pool, sizeTreeMap(tree)))) {
+        free(list.spans);
+        return 0;
+    }
+    ReduceJob r = { { runSpan, list.count }, list.spans, NULL, accSize, fold, NULL, data };
+    r.accs = (char *)malloc(list.count * accSize + 1);
+    if (r.accs == NULL) {
+        free(list.spans);
+        return 0;
+    }
+    for (long i = 0; i < list.count; i++) memcpy(r.accs + i * accSize, acc, accSize);
+    poolRun(pool, &r.job);
+    //se combinan en orden: el acumulador de la izquierda recibe al siguiente
+    for (long i = 0; i < list.count; i++) combine(acc, r.accs + i * accSize, data);
+    free(r.accs);
+    free(list.spans);
+    return 1;
+}
+
+int forEachTreeMap(TreeMapPool * pool, TreeMap * tree,
+                   void (*visit) (Pair* pair, long rank, void* data), void* data) {
+    if (tree == NULL || visit == NULL) return 0;
+    SpanList list;
+    if (!spanTreeMap(&list, tree, poolGrain(pool, sizeTreeMap(tree)))) {
+        free(list.spans);
+        return 0;
+    }
+    ReduceJob r = { { runSpan, list.count }, list.spans, NULL, 0, NULL, visit, data };
+    poolRun(pool, &r.job);
+    free(list.spans);
+    return 1;
+}
+
+//construccion: los niveles de arriba se arman en el hilo que llama y los
+//subarboles de a lo mas grain pares quedan como piezas
+typedef struct BuildPiece {
+    int lo, hi;
+    TreeNode * parent;
+    TreeNode ** slot;
+} BuildPiece;
+
+typedef struct BuildJob {
+    PoolJob job;
+    TreeMap * tree;
+    TreeNode * nodes;
+    Pair * pairs;
+    int n;
+    BuildPiece * pieces;
+    TreeNode ** top; //nodos de arriba en preorden
+    int topCount;
+} BuildJob;
+
+void buildTop(BuildJob* b, int lo, int hi, TreeNode* parent, TreeNode** slot, int grain) {
+    if (hi - lo + 1 <= grain) {
+        *slot = NULL;
+        if (lo <= hi) b->pieces[b->job.pieces++] = (BuildPiece){ lo, hi, parent, slot };
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    TreeNode* node = nodeAt(b->tree, b->nodes, mid);
+    node->pair = &node->entry;
+    node->entry = b->pairs[mid];
+    node->parent = parent;
+    node->pooled = 1;
+    if (b->tree->stringKeys) PREFIX(b->tree, node) = keyPrefix((const char*) node->entry.key);
+    *slot = node;
+    b->top[b->topCount++] = node;
+    buildTop(b, lo, mid - 1, node, &node->left, grain);
+    buildTop(b, mid + 1, hi, node, &node->right, grain);
+}
+
+void runBuild(PoolJob* job, long piece) {
+    BuildJob* b = (BuildJob *)job;
+    BuildPiece* p = &b->pieces[piece];
+    *p->slot = buildSubtree(b->tree, b->nodes, b->pairs, p->lo, p->hi, p->parent);
+    if (b->tree->threaded) threadRange(b->tree, b->nodes, b->n, p->lo, p->hi);
+}
+
+void buildParallelTreeMap(TreeMapPool * pool, TreeMap * tree, Pair * pairs, int n) {
+    if (tree == NULL || n <= 0 || tree->file != NULL) return;
+    int grain = (int) poolGrain(pool, n);
+    if (tree->btree != NULL || tree->root != NULL || n <= grain) {
+        buildTreeMap(tree, pairs, n);
+        return;
+    }
+    //cada pieza tiene al menos grain/2 pares y hay menos nodos arriba
+    //que piezas
+    int most = n / (grain / 2) + 1;
+    BuildJob b = { { runBuild, 0 }, tree, NULL, pairs, n, NULL, NULL, 0 };
+    b.pieces = (BuildPiece *)malloc(most * sizeof(BuildPiece));
+    b.top = (TreeNode **)malloc(most * sizeof(TreeNode*));
+    if (b.pieces == NULL || b.top == NULL) {
+        free(b.pieces);
+        free(b.top);
+        buildTreeMap(tree, pairs, n);
+        return;
+    }
+    b.nodes = reserveNodes(tree, n);
+    if (b.nodes == NULL) {
+        free(b.pieces);
+        free(b.top);
+        return;
+    }
+    ADD_STAT(tree, allocs, n);
+    ADD_STAT(tree, nodeBytes, sizeof(NodeSlab) + (size_t) n * tree->pool.nodeSize);
+    buildTop(&b, 0, n - 1, NULL, &tree->root, grain);
+    poolRun(pool, &b.job);
+    //de abajo hacia arriba: en preorden inverso los hijos van antes
+    for (int i = b.topCount - 1; i >= 0; i--) {
+        avl_update(b.top[i]);
+        long k = ((char *)b.top[i] - (char *)b.nodes) / tree->pool.nodeSize;
+        if (tree->threaded) threadRange(tree, b.nodes, n, k, k);
+    }
+    tree->current = NULL;
+    reindex(tree);
+    free(b.pieces);
+    free(b.top);
+}
+
+/* ---- busqueda por lotes ---- */
+
+//busquedas que avanzan juntas; cada una prefetchea su siguiente nodo
+#define BATCH_GROUP 16
+
+int searchBatchTreeMap(TreeMap* tree, void** keys, int n, Pair** out) {
+    if (tree == NULL) return 0;
+    int hits = 0;
+
+    if (tree->btree != NULL || tree->file != NULL || tree->index != NULL) {
+        for (int i = 0; i < n; i++) {
+            out[i] = lookupTreeMap(tree, keys[i]);
+            hits += out[i] != NULL;
+        }
+        return hits;
+    }
+
+    TreeNode* node[BATCH_GROUP];
+    TreeNode* candidate[BATCH_GROUP];
+    for (int base = 0; base < n; base += BATCH_GROUP) {
+        int size = n - base < BATCH_GROUP ? n - base : BATCH_GROUP;
+        int pending = 0;
+        for (int i = 0; i < size; i++) {
+            node[i] = tree->root;
+            candidate[i] = NULL;
+            pending += node[i] != NULL;
+        }
+
+        //mismo descenso que ceilingNode, un nivel por ronda para cada clave
+        while (pending > 0) {
+            for (int i = 0; i < size; i++) {
+                if (node[i] != NULL) PREFETCH(node[i]->entry.key);
+            }
+            for (int i = 0; i < size; i++) {
+                TreeNode* x = node[i];
+                if (x == NULL) continue;
+                if (!lowerThan(tree, x->entry.key, keys[base + i])) {
+                    candidate[i] = x;
+                    x = x->left;
+                } else {
+                    x = x->right;
+                }
+                if (x != NULL) PREFETCH(x);
+                else pending--;
+                node[i] = x;
+            }
+        }
+
+        for (int i = 0; i < size; i++) {
+            TreeNode* c = candidate[i];
+            if (c != NULL && !lowerThan(tree, keys[base + i], c->entry.key)) {
+                out[base + i] = c->pair;
+                hits++;
+            } else {
+                out[base + i] = NULL;
+            }
+        }
+    }
+    return hits;
+}
+
+#ifdef TREEMAP_STATS
+void statsDepth(TreeMapStats* out, int depth, long count) {
+    int bucket = depth <= TREEMAP_STATS_DEPTHS ? depth - 1 : TREEMAP_STATS_DEPTHS - 1;
+    out->depthHistogram[bucket] += count;
+    out->entries += count;
+    out->avgDepth += (double) depth * count; //se divide al final
+    if (depth > out->maxDepth) out->maxDepth = depth;
+}
+
+//en orden subiendo por parent, sin recursion (un mapa splay puede ser
+//tan profundo como n)
+void statsSubtree(TreeMapStats* out, TreeNode* node, int depth) {
+    TreeNode* top = node;
+    while (node != NULL && node->left != NULL) {
+        node = node->left;
+        depth++;
+    }
+    while (node != NULL) {
+        statsDepth(out, depth, 1);
+        if (!node->pooled) out->nodeBytes += sizeof(TreeNode);
+        if (node->right != NULL) {
+            node = node->right;
+            depth++;
+            while (node->left != NULL) {
+                node = node->left;
+                depth++;
+            }
+            continue;
+        }
+        while (node != top && node == node->parent->right) {
+            node = node->parent;
+            depth--;
+        }
+        node = node == top ? NULL : node->parent;
+        depth--;
+    }
+}
+
+void statsBTree(TreeMapStats* out, BNode* node, int depth) {
+    if (node->leaf) {
+        out->nodeBytes += sizeof(BLeaf);
+        statsDepth(out, depth, node->count);
+        return;
+    }
+    out->nodeBytes += sizeof(BInner);
+    BInner* in = (BInner *)node;
+    for (int i = 0; i <= in->hdr.count; i++) statsBTree(out, in->children[i], depth + 1);
+}
+
+void statsTreeMap(TreeMap* tree, TreeMapStats* out) {
+    if (out == NULL) return;
+    memset(out, 0, sizeof(TreeMapStats));
+    if (tree == NULL) return;
+    out->comparisons = tree->stats.comparisons;
+    out->allocs = tree->stats.allocs;
+    out->frees = tree->stats.frees;
+
+    if (tree->btree != NULL) {
+        if (tree->btree->root != NULL) statsBTree(out, tree->btree->root, 1);
+    } else if (tree->file != NULL) {
+        out->entries = tree->file->count; //sin nodos: indice y datos mapeados
+        out->nodeBytes = tree->file->length;
+    } else {
+        out->nodeBytes = tree->stats.nodeBytes; //slabs del pool
+        statsSubtree(out, tree->root, 1);
+    }
+    out->pairBytes = out->entries * sizeof(Pair);
+    if (out->entries > 0) out->avgDepth /= out->entries;
+}
+
+void resetStatsTreeMap(TreeMap* tree) {
+    if (tree == NULL) return;
+    tree->stats.comparisons = 0;
+    tree->stats.allocs = 0;
+    tree->stats.frees = 0;
+}
+#endif
+
+/* ---- mapa concurrente: lectores sin locks (estilo RCU) ---- */
+
+//los nodos son inmutables: cada escritura copia el camino hasta la raiz y
+//publica la nueva raiz; los nodos reemplazados se liberan cuando ningun
+//lector puede estar usandolos
+typedef struct PNode PNode;
+
+struct PNode {
+    void * key;
+    void * value;
+    PNode * left;
+    PNode * right;
+    int height;
+};
+
+#define READER_STRIPES 16
+
+typedef struct ReaderSlot {
+    atomic_long count;
+    char pad[64 - sizeof(atomic_long)];
+} ReaderSlot;
+
+struct ConcurrentTreeMap {
+    _Atomic(PNode *) root;
+    atomic_uint epoch;
+    ReaderSlot readers[2][READER_STRIPES];
+    pthread_mutex_t writeLock;
+    int (*lower_than) (void* key1, void* key2);
+    PNode ** retired;
+    int retiredCount;
+    int retiredCap;
+    PNode * spare; //nodos reservados para la proxima escritura
+    int spareCount;
+};
+
+int pheight(PNode* x) {
+    return x == NULL ? 0 : x->height;
+}
+
+//antes de copiar el camino se reservan los nodos y el espacio en retired
+//que puede usar la escritura (a lo mas 3 por nivel), asi una falta de
+//memoria deja el arbol como estaba en vez de a medio copiar
+int pnodeReserve(ConcurrentTreeMap* map) {
+    int need = 3 * (pheight(atomic_load(&map->root)) + 1);
+    while (map->spareCount < need) {
+        PNode* node = (PNode *)malloc(sizeof(PNode));
+        if (node == NULL) return 0;
+        node->left = map->spare;
+        map->spare = node;
+        map->spareCount++;
+    }
+    if (map->retiredCap - map->retiredCount < need) {
+        int cap = map->retiredCount + need;
+        PNode** retired = (PNode **)realloc(map->retired, cap * sizeof(PNode*));
+        if (retired == NULL) return 0;
+        map->retired = retired;
+        map->retiredCap = cap;
+    }
+    return 1;
+}
+
+PNode* pnodeMake(ConcurrentTreeMap* map, void* key, void* value, PNode* left, PNode* right) {
+    PNode* node = map->spare;
+    map->spare = node->left;
+    map->spareCount--;
+    node->key = key;
+    node->value = value;
+    node->left = left;
+    node->right = right;
+    int hl = pheight(left), hr = pheight(right);
+    node->height = 1 + (hl > hr ? hl : hr);
+    return node;
+}
+
+void pnodeRetire(ConcurrentTreeMap* map, PNode* node) {
+    map->retired[map->retiredCount++] = node; //espacio reservado en pnodeReserve
+}
+
+//arma un nodo (key,value,left,right) rotando si queda desbalanceado
+PNode* pnodeBalance(ConcurrentTreeMap* map, void* key, void* value, PNode* left, PNode* right) {
+    if (pheight(left) > pheight(right) + 1) {
+        if (pheight(left->left) >= pheight(left->right)) {
+            pnodeRetire(map, left);
+            return pnodeMake(map, left->key, left->value, left->left,
+                             pnodeMake(map, key, value, left->right, right));
+        }
+        PNode* mid = left->right;
+        pnodeRetire(map, left);
+        pnodeRetire(map, mid);
+        return pnodeMake(map, mid->key, mid->value,
+                         pnodeMake(map, left->key, left->value, left->left, mid->left),
+                         pnodeMake(map, key, value, mid->right, right));
+    }
+    if (pheight(right) > pheight(left) + 1) {
+        if (pheight(right->right) >= pheight(right->left)) {
+            pnodeRetire(map, right);
+            return pnodeMake(map, right->key, right->value,
+                             pnodeMake(map, key, value, left, right->left), right->right);
+        }
+        PNode* mid = right->left;
+        pnodeRetire(map, right);
+        pnodeRetire(map, mid);
+        return pnodeMake(map, mid->key, mid->value,
+                         pnodeMake(map, key, value, left, mid->left),
+                         pnodeMake(map, right->key, right->value, mid->right, right->right));
+    }
+    return pnodeMake(map, key, value, left, right);
+}
+
+//retorna la nueva raiz del subarbol, o t si la clave ya existia
+PNode* pnodeInsert(ConcurrentTreeMap* map, PNode* t, void* key, void* value) {
+    if (t == NULL) return pnodeMake(map, key, value, NULL, NULL);
+    if (map->lower_than(key, t->key)) {
+        PNode* left = pnodeInsert(map, t->left, key, value);
+        if (left == t->left) return t;
+        pnodeRetire(map, t);
+        return pnodeBalance(map, t->key, t->value, left, t->right);
+    }
+    if (map->lower_than(t->key, key)) {
+        PNode* right = pnodeInsert(map, t->right, key, value);
+        if (right == t->right) return t;
+        pnodeRetire(map, t);
+        return pnodeBalance(map, t->key, t->value, t->left, right);
+    }
+    return t;
+}
+
+PNode* pnodeRemoveMin(ConcurrentTreeMap* map, PNode* t, PNode** min) {
+    pnodeRetire(map, t);
+    if (t->left == NULL) {
+        *min = t;
+        return t->right;
+    }
+    PNode* left = pnodeRemoveMin(map, t->left, min);
+    return pnodeBalance(map, t->key, t->value, left, t->right);
+}
+
+PNode* pnodeErase(ConcurrentTreeMap* map, PNode* t, void* key) {
+    if (t == NULL) return NULL;
+    if (map->lower_than(key, t->key)) {
+        PNode* left = pnodeErase(map, t->left, key);
+        if (left == t->left) return t;
+        pnodeRetire(map, t);
+        return pnodeBalance(map, t->key, t->value, left, t->right);
+    }
+    if (map->lower_than(t->key, key)) {
+        PNode* right = pnodeErase(map, t->right, key);
+        if (right == t->right) return t;
+        pnodeRetire(map, t);
+        return pnodeBalance(map, t->key, t->value, t->left, right);
+    }
+    pnodeRetire(map, t);
+    if (t->left == NULL) return t->right;
+    if (t->right == NULL) return t->left;
+    PNode* min;
+    PNode* right = pnodeRemoveMin(map, t->right, &min);
+    return pnodeBalance(map, min->key, min->value, t->left, right);
+}
+
+void pnodeFree(PNode* t) {
+    while (t != NULL) {
+        PNode* right = t->right;
+        pnodeFree(t->left);
+        free(t);
+        t = right;
+    }
+}
+
+int readerStripe(void) {
+    static atomic_int nextStripe;
+    static _Thread_local int stripe = -1;
+    if (stripe < 0) stripe = atomic_fetch_add(&nextStripe, 1) % READER_STRIPES;
+    return stripe;
+}
+
+//espera a que terminen los lectores que pudieron ver la raiz anterior;
+//se cambia la paridad dos veces para cubrir lectores que leyeron una
+//paridad antigua antes de registrarse
+void synchronizeReaders(ConcurrentTreeMap* map) {
+    for (int flip = 0; flip < 2; flip++) {
+        unsigned int old = atomic_fetch_add(&map->epoch, 1) & 1;
+        for (int i = 0; i < READER_STRIPES; i++) {
+            while (atomic_load(&map->readers[old][i].count) != 0) sched_yield();
+        }
+    }
+}
+
+void publishRoot(ConcurrentTreeMap* map, PNode* root) {
+    atomic_store(&map->root, root);
+    if (map->retiredCount == 0) return;
+    synchronizeReaders(map);
+    for (int i = 0; i < map->retiredCount; i++) free(map->retired[i]);
+    map->retiredCount = 0;
+}
+
+ConcurrentTreeMap * createConcurrentTreeMap(int (*lower_than) (void* key1, void* key2)) {
+    ConcurrentTreeMap * map = (ConcurrentTreeMap *)calloc(1, sizeof(ConcurrentTreeMap));
+    if (map == NULL) return NULL;
+    atomic_init(&map->root, NULL);
+    atomic_init(&map->epoch, 0);
+    pthread_mutex_init(&map->writeLock, NULL);
+    map->lower_than = lower_than;
+    return map;
+}
+
+void destroyConcurrentTreeMap(ConcurrentTreeMap * map) {
+    if (map == NULL) return;
+    pnodeFree(atomic_load(&map->root));
+    while (map->spare != NULL) {
+        PNode* next = map->spare->left;
+        free(map->spare);
+        map->spare = next;
+    }
+    free(map->retired);
+    pthread_mutex_destroy(&map->writeLock);
+    free(map);
+}
+
+void insertConcurrentTreeMap(ConcurrentTreeMap * map, void* key, void * value) {
+    if (map == NULL || key == NULL || value == NULL) return;
+    pthread_mutex_lock(&map->writeLock);
+    if (!pnodeReserve(map)) {
+        pthread_mutex_unlock(&map->writeLock);
+        return;
+    }
+    PNode* root = atomic_load(&map->root);
+    PNode* updated = pnodeInsert(map, root, key, value);
+    if (updated != root) publishRoot(map, updated);
+    pthread_mutex_unlock(&map->writeLock);
+}
+
+void eraseConcurrentTreeMap(ConcurrentTreeMap * map, void* key) {
+    if (map == NULL) return;
+    pthread_mutex_lock(&map->writeLock);
+    if (!pnodeReserve(map)) {
+        pthread_mutex_unlock(&map->writeLock);
+        return;
+    }
+    PNode* root = atomic_load(&map->root);
+    PNode* updated = pnodeErase(map, root, key);
+    if (updated != root || map->retiredCount > 0) publishRoot(map, updated);
+    pthread_mutex_unlock(&map->writeLock);
+}
+
+//lectura sin locks: upper=0 busca key exacta, upper=1 la menor clave >= key
+int readConcurrentTreeMap(ConcurrentTreeMap * map, void* key, int upper, Pair * out) {
+    int stripe = readerStripe();
+    unsigned int idx = atomic_load(&map->epoch) & 1;
+    atomic_fetch_add(&map->readers[idx][stripe].count, 1);
+
+    PNode* node = atomic_load(&map->root);
+    PNode* candidate = NULL;
+    while (node != NULL) {
+        if (!map->lower_than(node->key, key)) {
+            candidate = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    if (candidate != NULL && !upper && map->lower_than(key, candidate->key)) {
+        candidate = NULL;
+    }
+    if (candidate != NULL && out != NULL) {
+        out->key = candidate->key;
+        out->value = candidate->value;
+    }
+
+    atomic_fetch_sub(&map->readers[idx][stripe].count, 1);
+    return candidate != NULL;
+}
+
+int searchConcurrentTreeMap(ConcurrentTreeMap * map, void* key, Pair * out) {
+    return readConcurrentTreeMap(map, key, 0, out);
+}
+
+int upperBoundConcurrentTreeMap(ConcurrentTreeMap * map, void* key, Pair * out) {
+    return readConcurrentTreeMap(map, key, 1, out);
+}
+
+/* ---- mapa persistente: copia de caminos con nodos compartidos ---- */
+
+//cada nodo es inmutable y cuenta cuantos padres o versiones lo usan; una
+//escritura copia solo el camino modificado y comparte el resto
+typedef struct RNode RNode;
+
+struct RNode {
+    Pair entry;
+    RNode * left;
+    RNode * right;
+    atomic_int refs;
+    int height;
+    long size;
+};
+
+#define PERSISTENT_MAX_HEIGHT 64
+
+struct PersistentTreeMap {
+    RNode * root;
+    int (*lower_than) (void* key1, void* key2);
+    RNode * path[PERSISTENT_MAX_HEIGHT]; //ancestros pendientes de current
+    int depth;
+    RNode * spare; //nodos reservados para la proxima escritura
+    int spareCount;
+};
+
+int rheight(RNode* x) {
+    return x == NULL ? 0 : x->height;
+}
+
+long rsize(RNode* x) {
+    return x == NULL ? 0 : x->size;
+}
+
+RNode* rnodeRetain(RNode* x) {
+    if (x != NULL) atomic_fetch_add_explicit(&x->refs, 1, memory_order_relaxed);
+    return x;
+}
+
+void rnodeRelease(RNode* x) {
+    while (x != NULL && atomic_fetch_sub_explicit(&x->refs, 1, memory_order_acq_rel) == 1) {
+        RNode* right = x->right;
+        rnodeRelease(x->left);
+        free(x);
+        x = right;
+    }
+}
+
+//como pnodeReserve: una escritura usa a lo mas 3 nodos nuevos por nivel
+int rnodeReserve(PersistentTreeMap* map) {
+    int need = 3 * (rheight(map->root) + 1);
+    while (map->spareCount < need) {
+        RNode* node = (RNode *)malloc(sizeof(RNode));
+        if (node == NULL) return 0;
+        node->left = map->spare;
+        map->spare = node;
+        map->spareCount++;
+    }
+    return 1;
+}
+
+//nuevo nodo dueno de las referencias left y right
+RNode* rnodeMake(PersistentTreeMap* map, void* key, void* value, RNode* left, RNode* right) {
+    RNode* node = map->spare;
+    map->spare = node->left;
+    map->spareCount--;
+    node->entry.key = key;
+    node->entry.value = value;
+    node->left = left;
+    node->right = right;
+    atomic_init(&node->refs, 1);
+    int hl = rheight(left), hr = rheight(right);
+    node->height = 1 + (hl > hr ? hl : hr);
+    node->size = 1 + rsize(left) + rsize(right);
+    return node;
+}
+
+//como pnodeBalance, pero left y right son referencias propias que se
+//entregan a los nodos nuevos
+RNode* rnodeBalance(PersistentTreeMap* map, void* key, void* value, RNode* left, RNode* right) {
+    RNode* t;
+    if (rheight(left) > rheight(right) + 1) {
+        if (rheight(left->left) >= rheight(left->right)) {
+            t = rnodeMake(map, left->entry.key, left->entry.value, rnodeRetain(left->left),
+                          rnodeMake(map, key, value, rnodeRetain(left->right), right));
+        } else {
+            RNode* mid = left->right;
+            t = rnodeMake(map, mid->entry.key, mid->entry.value,
+                          rnodeMake(map, left->entry.key, left->entry.value,
+                                    rnodeRetain(left->left), rnodeRetain(mid->left)),
+                          rnodeMake(map, key, value, rnodeRetain(mid->right), right));
+        }
+        rnodeRelease(left);
+        return t;
+    }
+    if (rheight(right) > rheight(left) + 1) {
+        if (rheight(right->right) >= rheight(right->left)) {
+            t = rnodeMake(map, right->entry.key, right->entry.value,
+                          rnodeMake(map, key, value, left, rnodeRetain(right->left)),
+                          rnodeRetain(right->right));
+        } else {
+            RNode* mid = right->left;
+            t = rnodeMake(map, mid->entry.key, mid->entry.value,
+                          rnodeMake(map, key, value, left, rnodeRetain(mid->left)),
+                          rnodeMake(map, right->entry.key, right->entry.value,
+                                    rnodeRetain(mid->right), rnodeRetain(right->right)));
+        }
+        rnodeRelease(right);
+        return t;
+    }
+    return rnodeMake(map, key, value, left, right);
+}
+
+//retorna una referencia a la nueva raiz del subarbol (t mismo si no cambia)
+RNode* rnodeInsert(PersistentTreeMap* map, RNode* t, void* key, void* value) {
+    if (t == NULL) return rnodeMake(map, key, value, NULL, NULL);
+    if (map->lower_than(key, t->entry.key)) {
+        RNode* left = rnodeInsert(map, t->left, key, value);
+        if (left == t->left) {
+            rnodeRelease(left);
+            return rnodeRetain(t);
+        }
+        return rnodeBalance(map, t->entry.key, t->entry.value, left, rnodeRetain(t->right));
+    }
+    if (map->lower_than(t->entry.key, key)) {
+        RNode* right = rnodeInsert(map, t->right, key, value);
+        if (right == t->right) {
+            rnodeRelease(right);
+            return rnodeRetain(t);
+        }
+        return rnodeBalance(map, t->entry.key, t->entry.value, rnodeRetain(t->left), right);
+    }
+    return rnodeRetain(t);
+}
+
+RNode* rnodeRemoveMin(PersistentTreeMap* map, RNode* t, RNode** min) {
+    if (t->left == NULL) {
+        *min = t;
+        return rnodeRetain(t->right);
+    }
+    RNode* left = rnodeRemoveMin(map, t->left, min);
+    return rnodeBalance(map, t->entry.key, t->entry.value, left, rnodeRetain(t->right));
+}
+
+RNode* rnodeErase(PersistentTreeMap* map, RNode* t, void* key) {
+    if (t == NULL) return NULL;
+    if (map->lower_than(key, t->entry.key)) {
+        RNode* left = rnodeErase(map, t->left, key);
+        if (left == t->left) {
+            rnodeRelease(left);
+            return rnodeRetain(t);
+        }
+        return rnodeBalance(map, t->entry.key, t->entry.value, left, rnodeRetain(t->right));
+    }
+    if (map->lower_than(t->entry.key, key)) {
+        RNode* right = rnodeErase(map, t->right, key);
+        if (right == t->right) {
+            rnodeRelease(right);
+            return rnodeRetain(t);
+        }
+        return rnodeBalance(map, t->entry.key, t->entry.value, rnodeRetain(t->left), right);
+    }
+    if (t->left == NULL) return rnodeRetain(t->right);
+    if (t->right == NULL) return rnodeRetain(t->left);
+    RNode* min;
+    RNode* right = rnodeRemoveMin(map, t->right, &min);
+    return rnodeBalance(map, min->entry.key, min->entry.value, rnodeRetain(t->left), right);
+}
+
+PersistentTreeMap * createPersistentTreeMap(int (*lower_than) (void* key1, void* key2)) {
+    PersistentTreeMap * map = (PersistentTreeMap *)malloc(sizeof(PersistentTreeMap));
+    if (map == NULL) return NULL;
+    map->root = NULL;
+    map->lower_than = lower_than;
+    map->depth = 0;
+    map->spare = NULL;
+    map->spareCount = 0;
+    return map;
+}
+
+PersistentTreeMap * snapshotPersistentTreeMap(PersistentTreeMap * map) {
+    if (map == NULL) return NULL;
+    PersistentTreeMap * copy = createPersistentTreeMap(map->lower_than);
+    if (copy == NULL) return NULL;
+    copy->root = rnodeRetain(map->root);
+    return copy;
+}
+
+void destroyPersistentTreeMap(PersistentTreeMap * map) {
+    if (map == NULL) return;
+    rnodeRelease(map->root);
+    while (map->spare != NULL) {
+        RNode* next = map->spare->left;
+        free(map->spare);
+        map->spare = next;
+    }
+    free(map);
+}
+
+void setPersistentRoot(PersistentTreeMap * map, RNode* root) {
+    rnodeRelease(map->root);
+    map->root = root;
+    map->depth = 0; //la iteracion en curso queda invalida
+}
+
+void insertPersistentTreeMap(PersistentTreeMap * map, void* key, void * value) {
+    if (map == NULL || key == NULL || value == NULL || !rnodeReserve(map)) return;
+    setPersistentRoot(map, rnodeInsert(map, map->root, key, value));
+}
+
+void erasePersistentTreeMap(PersistentTreeMap * map, void* key) {
+    if (map == NULL || !rnodeReserve(map)) return;
+    setPersistentRoot(map, rnodeErase(map, map->root, key));
+}
+
+Pair * searchPersistentTreeMap(PersistentTreeMap * map, void* key) {
+    Pair * p = upperBoundPersistentTreeMap(map, key);
+    if (p == NULL || map->lower_than(key, p->key)) return NULL;
+    return p;
+}
+
+Pair * upperBoundPersistentTreeMap(PersistentTreeMap * map, void* key) {
+    if (map == NULL) return NULL;
+    RNode* node = map->root;
+    RNode* candidate = NULL;
+    while (node != NULL) {
+        if (!map->lower_than(node->entry.key, key)) {
+            candidate = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return candidate == NULL ? NULL : &candidate->entry;
+}
+
+long sizePersistentTreeMap(PersistentTreeMap * map) {
+    return map == NULL ? 0 : rsize(map->root);
+}
+
+//sin punteros al padre: path guarda los ancestros cuyo par falta visitar
+void pushLeftPath(PersistentTreeMap * map, RNode* node) {
+    while (node != NULL && map->depth < PERSISTENT_MAX_HEIGHT) {
+        map->path[map->depth++] = node;
+        node = node->left;
+    }
+}
+
+Pair * firstPersistentTreeMap(PersistentTreeMap * map) {
+    if (map == NULL) return NULL;
+    map->depth = 0;
+    pushLeftPath(map, map->root);
+    return map->depth == 0 ? NULL : &map->path[map->depth - 1]->entry;
+}
+
+Pair * nextPersistentTreeMap(PersistentTreeMap * map) {
+    if (map == NULL || map->depth == 0) return NULL;
+    RNode* node = map->path[--map->depth];
+    pushLeftPath(map, node->right);
+    return map->depth == 0 ? NULL : &map->path[map->depth - 1]->entry;
+}
+
+/* ---- mapa de claves enteras: B+tree con claves dentro de los nodos ---- */
+
+#define INT_ORDER 32
+#define INT_INNER_MIN ((INT_ORDER - 1) / 2)
+#define INT_LEAF_MIN (INT_ORDER / 2)
+
+typedef struct INode {
+    int leaf;
+    int count;
+} INode;
+
+typedef struct IInner {
+    INode hdr;
+    long long keys[INT_ORDER - 1];
+    INode * children[INT_ORDER];
+} IInner;
+
+typedef struct ILeaf ILeaf;
+
+struct ILeaf {
+    INode hdr;
+    ILeaf * next;
+    ILeaf * prev;
+    long long keys[INT_ORDER];
+    void * values[INT_ORDER];
+};
+
+struct IntTreeMap {
+    INode * root;
+    ILeaf * curLeaf;
+    int curIndex;
+    long size;
+    INode * spare; //internos reservados para divisiones, enlazados por children[0]
+    int spareCount;
+    INode * spareLeaf;
+};
+
+//cuenta sin saltos las claves < key (o <= key si inclusive); el
+//compilador lo vectoriza
+int intCountBelow(const long long* keys, int n, long long key, int inclusive) {
+    int count = 0;
+    if (inclusive) {
+        for (int i = 0; i < n; i++) count += keys[i] <= key;
+    } else {
+        for (int i = 0; i < n; i++) count += keys[i] < key;
+    }
+    return count;
+}
+
+INode* intNewNode(int leaf) {
+    INode* node;
+    if (leaf) {
+        ILeaf* l = (ILeaf *)malloc(sizeof(ILeaf));
+        if (l == NULL) return NULL;
+        l->next = l->prev = NULL;
+        node = &l->hdr;
+    } else {
+        IInner* in = (IInner *)malloc(sizeof(IInner));
+        if (in == NULL) return NULL;
+        node = &in->hdr;
+    }
+    node->leaf = leaf;
+    node->count = 0;
+    return node;
+}
+
+void intFreeNode(INode* node) {
+    if (node == NULL) return;
+    if (!node->leaf) {
+        IInner* in = (IInner *)node;
+        for (int i = 0; i <= in->hdr.count; i++) intFreeNode(in->children[i]);
+    }
+    free(node);
+}
+
+//como btreeReserve: la hoja y un interno por nivel antes de insertar
+int intReserve(IntTreeMap* map) {
+    int levels = 0;
+    for (INode* n = map->root; n != NULL; n = n->leaf ? NULL : ((IInner *)n)->children[0]) levels++;
+    if (map->spareLeaf == NULL) {
+        map->spareLeaf = intNewNode(1);
+        if (map->spareLeaf == NULL) return 0;
+    }
+    while (map->spareCount < levels) {
+        INode* node = intNewNode(0);
+        if (node == NULL) return 0;
+        ((IInner *)node)->children[0] = map->spare;
+        map->spare = node;
+        map->spareCount++;
+    }
+    return 1;
+}
+
+INode* intTakeNode(IntTreeMap* map, int leaf) {
+    INode* node;
+    if (leaf) {
+        node = map->spareLeaf;
+        map->spareLeaf = NULL;
+    } else {
+        node = map->spare;
+        map->spare = ((IInner *)node)->children[0];
+        map->spareCount--;
+    }
+    return node;
+}
+
+ILeaf* intFindLeaf(IntTreeMap* map, long long key) {
+    INode* node = map->root;
+    if (node == NULL) return NULL;
+    while (!node->leaf) {
+        IInner* in = (IInner *)node;
+        node = in->children[intCountBelow(in->keys, in->hdr.count, key, 1)];
+    }
+    return (ILeaf *)node;
+}
+
+INode* intInsertRec(IntTreeMap* map, INode* node, long long key, void* value, long long* sep) {
+    if (node->leaf) {
+        ILeaf* leaf = (ILeaf *)node;
+        int pos = intCountBelow(leaf->keys, leaf->hdr.count, key, 0);
+        if (pos < leaf->hdr.count && leaf->keys[pos] == key) return NULL;
+
+        ILeaf* target = leaf;
+        ILeaf* right = NULL;
+        if (leaf->hdr.count == INT_ORDER) {
+            right = (ILeaf *)intTakeNode(map, 1);
+            int half = INT_ORDER / 2;
+            right->hdr.count = INT_ORDER - half;
+            memcpy(right->keys, leaf->keys + half, right->hdr.count * sizeof(long long));
+            memcpy(right->values, leaf->values + half, right->hdr.count * sizeof(void*));
+            leaf->hdr.count = half;
+            right->next = leaf->next;
+            if (right->next != NULL) right->next->prev = right;
+            right->prev = leaf;
+            leaf->next = right;
+            if (pos > half) {
+                target = right;
+                pos -= half;
+            }
+        }
+
+        int move = target->hdr.count - pos;
+        memmove(target->keys + pos + 1, target->keys + pos, move * sizeof(long long));
+        memmove(target->values + pos + 1, target->values + pos, move * sizeof(void*));
+        target->keys[pos] = key;
+        target->values[pos] = value;
+        target->hdr.count++;
+        map->size++;
+        map->curLeaf = target;
+        map->curIndex = pos;
+
+        if (right == NULL) return NULL;
+        *sep = right->keys[0];
+        return &right->hdr;
+    }
+
+    IInner* in = (IInner *)node;
+    int i = intCountBelow(in->keys, in->hdr.count, key, 1);
+    long long childSep;
+    INode* split = intInsertRec(map, in->children[i], key, value, &childSep);
+    if (split == NULL) return NULL;
+
+    if (in->hdr.count < INT_ORDER - 1) {
+        memmove(in->keys + i + 1, in->keys + i, (in->hdr.count - i) * sizeof(long long));
+        memmove(in->children + i + 2, in->children + i + 1,
+                (in->hdr.count - i) * sizeof(INode*));
+        in->keys[i] = childSep;
+        in->children[i + 1] = split;
+        in->hdr.count++;
+        return NULL;
+    }
+
+    long long keys[INT_ORDER];
+    INode* children[INT_ORDER + 1];
+    memcpy(keys, in->keys, i * sizeof(long long));
+    keys[i] = childSep;
+    memcpy(keys + i + 1, in->keys + i, (INT_ORDER - 1 - i) * sizeof(long long));
+    memcpy(children, in->children, (i + 1) * sizeof(INode*));
+    children[i + 1] = split;
+    memcpy(children + i + 2, in->children + i + 1, (INT_ORDER - 1 - i) * sizeof(INode*));
+
+    IInner* right = (IInner *)intTakeNode(map, 0);
+    int mid = INT_ORDER / 2;
+    in->hdr.count = mid;
+    memcpy(in->keys, keys, mid * sizeof(long long));
+    memcpy(in->children, children, (mid + 1) * sizeof(INode*));
+    right->hdr.count = INT_ORDER - 1 - mid;
+    memcpy(right->keys, keys + mid + 1, right->hdr.count * sizeof(long long));
+    memcpy(right->children, children + mid + 1, (right->hdr.count + 1) * sizeof(INode*));
+    *sep = keys[mid];
+    return &right->hdr;
+}
+
+//mueve count pares de la hoja src (desde from) a dst (desde to)
+void intLeafCopy(ILeaf* dst, int to, ILeaf* src, int from, int count) {
+    memmove(dst->keys + to, src->keys + from, count * sizeof(long long));
+    memmove(dst->values + to, src->values + from, count * sizeof(void*));
+}
+
+void intFixChild(IInner* in, int i) {
+    INode* child = in->children[i];
+    INode* left = i > 0 ? in->children[i - 1] : NULL;
+    INode* right = i < in->hdr.count ? in->children[i + 1] : NULL;
+    int min = child->leaf ? INT_LEAF_MIN : INT_INNER_MIN;
+
+    if (left != NULL && left->count > min) {
+        if (child->leaf) {
+            ILeaf* c = (ILeaf *)child;
+            ILeaf* l = (ILeaf *)left;
+            intLeafCopy(c, 1, c, 0, c->hdr.count);
+            l->hdr.count--;
+            intLeafCopy(c, 0, l, l->hdr.count, 1);
+            c->hdr.count++;
+            in->keys[i - 1] = c->keys[0];
+        } else {
+            IInner* c = (IInner *)child;
+            IInner* l = (IInner *)left;
+            memmove(c->keys + 1, c->keys, c->hdr.count * sizeof(long long));
+            memmove(c->children + 1, c->children, (c->hdr.count + 1) * sizeof(INode*));
+            c->keys[0] = in->keys[i - 1];
+            c->children[0] = l->children[l->hdr.count];
+            c->hdr.count++;
+            in->keys[i - 1] = l->keys[--l->hdr.count];
+        }
+        return;
+    }
+
+    if (right != NULL && right->count > min) {
+        if (child->leaf) {
+            ILeaf* c = (ILeaf *)child;
+            ILeaf* r = (ILeaf *)right;
+            intLeafCopy(c, c->hdr.count++, r, 0, 1);
+            intLeafCopy(r, 0, r, 1, --r->hdr.count);
+            in->keys[i] = r->keys[0];
+        } else {
+            IInner* c = (IInner *)child;
+            IInner* r = (IInner *)right;
+            c->keys[c->hdr.count] = in->keys[i];
+            c->children[++c->hdr.count] = r->children[0];
+            in->keys[i] = r->keys[0];
+            memmove(r->keys, r->keys + 1, (r->hdr.count - 1) * sizeof(long long));
+            memmove(r->children, r->children + 1, r->hdr.count * sizeof(INode*));
+            r->hdr.count--;
+        }
+        return;
+    }
+
+    int j = left != NULL ? i - 1 : i;
+    INode* a = in->children[j];
+    INode* b = in->children[j + 1];
+    if (a->leaf) {
+        ILeaf* la = (ILeaf *)a;
+        ILeaf* lb = (ILeaf *)b;
+        intLeafCopy(la, la->hdr.count, lb, 0, lb->hdr.count);
+        la->hdr.count += lb->hdr.count;
+        la->next = lb->next;
+        if (la->next != NULL) la->next->prev = la;
+    } else {
+        IInner* ia = (IInner *)a;
+        IInner* ib = (IInner *)b;
+        ia->keys[ia->hdr.count] = in->keys[j];
+        memcpy(ia->keys + ia->hdr.count + 1, ib->keys, ib->hdr.count * sizeof(long long));
+        memcpy(ia->children + ia->hdr.count + 1, ib->children,
+               (ib->hdr.count + 1) * sizeof(INode*));
+        ia->hdr.count += ib->hdr.count + 1;
+    }
+    free(b);
+    memmove(in->keys + j, in->keys + j + 1, (in->hdr.count - j - 1) * sizeof(long long));
+    memmove(in->children + j + 1, in->children + j + 2,
+            (in->hdr.count - j - 1) * sizeof(INode*));
+    in->hdr.count--;
+}
+
+//los separadores son copias de las claves, pueden quedar obsoletos sin riesgo
+int intEraseRec(INode* node, long long key) {
+    if (node->leaf) {
+        ILeaf* leaf = (ILeaf *)node;
+        int pos = intCountBelow(leaf->keys, leaf->hdr.count, key, 0);
+        if (pos == leaf->hdr.count || leaf->keys[pos] != key) return 0;
+        intLeafCopy(leaf, pos, leaf, pos + 1, leaf->hdr.count - pos - 1);
+        leaf->hdr.count--;
+        return 1;
+    }
+    IInner* in = (IInner *)node;
+    int i = intCountBelow(in->keys, in->hdr.count, key, 1);
+    if (!intEraseRec(in->children[i], key)) return 0;
+    int min = in->children[i]->leaf ? INT_LEAF_MIN : INT_INNER_MIN;
+    if (in->children[i]->count < min) intFixChild(in, i);
+    return 1;
+}
+
+IntTreeMap * createIntTreeMap(void) {
+    return (IntTreeMap *)calloc(1, sizeof(IntTreeMap));
+}
+
+void destroyIntTreeMap(IntTreeMap * map) {
+    if (map == NULL) return;
+    intFreeNode(map->root);
+    while (map->spare != NULL) {
+        INode* next = ((IInner *)map->spare)->children[0];
+        free(map->spare);
+        map->spare = next;
+    }
+    free(map->spareLeaf);
+    free(map);
+}
+
+void insertIntTreeMap(IntTreeMap * map, long long key, void * value) {
+    if (map == NULL || value == NULL) return;
+    if (map->root == NULL) {
+        map->root = intNewNode(1);
+        if (map->root == NULL) return;
+    }
+    if (!intReserve(map)) return;
+    long long sep;
+    INode* split = intInsertRec(map, map->root, key, value, &sep);
+    if (split == NULL) return;
+
+    IInner* root = (IInner *)intTakeNode(map, 0);
+    root->hdr.count = 1;
+    root->keys[0] = sep;
+    root->children[0] = map->root;
+    root->children[1] = split;
+    map->root = &root->hdr;
+}
+
+void eraseIntTreeMap(IntTreeMap * map, long long key) {
+    if (map == NULL || map->root == NULL) return;
+    if (!intEraseRec(map->root, key)) return;
+    map->size--;
+    map->curLeaf = NULL;
+
+    INode* root = map->root;
+    if (root->count == 0) {
+        map->root = root->leaf ? NULL : ((IInner *)root)->children[0];
+        free(root);
+    }
+}
+
+void * searchIntTreeMap(IntTreeMap * map, long long key) {
+    ILeaf* leaf = intFindLeaf(map, key);
+    if (leaf == NULL) return NULL;
+    int pos = intCountBelow(leaf->keys, leaf->hdr.count, key, 0);
+    if (pos == leaf->hdr.count || leaf->keys[pos] != key) return NULL;
+    return leaf->values[pos];
+}
+
+int intPairAt(ILeaf* leaf, int pos, IntPair* out) {
+    if (leaf == NULL) return 0;
+    if (out != NULL) {
+        out->key = leaf->keys[pos];
+        out->value = leaf->values[pos];
+    }
+    return 1;
+}
+
+//menor clave >= key (> key si strict)
+int intCeiling(IntTreeMap* map, long long key, int strict, IntPair* out) {
+    ILeaf* leaf = intFindLeaf(map, key);
+    if (leaf == NULL) return 0;
+    int pos = intCountBelow(leaf->keys, leaf->hdr.count, key, strict);
+    if (pos == leaf->hdr.count) {
+        leaf = leaf->next;
+        pos = 0;
+    }
+    return intPairAt(leaf, pos, out);
+}
+
+//mayor clave <= key (< key si strict)
+int intFloor(IntTreeMap* map, long long key, int strict, IntPair* out) {
+    ILeaf* leaf = intFindLeaf(map, key);
+    if (leaf == NULL) return 0;
+    int pos = intCountBelow(leaf->keys, leaf->hdr.count, key, !strict);
+    if (pos == 0) {
+        leaf = leaf->prev;
+        pos = leaf == NULL ? 0 : leaf->hdr.count;
+    }
+    return intPairAt(leaf, pos - 1, out);
+}
+
+int upperBoundIntTreeMap(IntTreeMap * map, long long key, IntPair * out) {
+    return map != NULL && intCeiling(map, key, 0, out);
+}
+
+int ceilingIntTreeMap(IntTreeMap * map, long long key, IntPair * out) {
+    return map != NULL && intCeiling(map, key, 0, out);
+}
+
+int floorIntTreeMap(IntTreeMap * map, long long key, IntPair * out) {
+    return map != NULL && intFloor(map, key, 0, out);
+}
+
+int higherIntTreeMap(IntTreeMap * map, long long key, IntPair * out) {
+    return map != NULL && intCeiling(map, key, 1, out);
+}
+
+int lowerIntTreeMap(IntTreeMap * map, long long key, IntPair * out) {
+    return map != NULL && intFloor(map, key, 1, out);
+}
+
+int firstIntTreeMap(IntTreeMap * map, IntPair * out) {
+    if (map == NULL) return 0;
+    INode* node = map->root;
+    while (node != NULL && !node->leaf) node = ((IInner *)node)->children[0];
+    map->curLeaf = (ILeaf *)node;
+    map->curIndex = 0;
+    return intPairAt(map->curLeaf, 0, out);
+}
+
+int nextIntTreeMap(IntTreeMap * map, IntPair * out) {
+    if (map == NULL || map->curLeaf == NULL) return 0;
+    if (++map->curIndex == map->curLeaf->hdr.count) {
+        map->curLeaf = map->curLeaf->next;
+        map->curIndex = 0;
+    }
+    return intPairAt(map->curLeaf, map->curIndex, out);
+}
+
+long sizeIntTreeMap(IntTreeMap * map) {
+    return map == NULL ? 0 : map->size;
 }
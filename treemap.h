@@ -1,6 +1,8 @@
 #ifndef TREEMAP_h
 #define TREEMAP_h
 
+#include <stddef.h>
+
 typedef struct TreeMap TreeMap;
 
 typedef struct Pair {
@@ -10,16 +12,342 @@ typedef struct Pair {
 
 TreeMap * createTreeMap(int (*lower_than_int) (void* key1, void* key2));
 
+/* compare retorna <0, 0 o >0 (como strcmp); una llamada por nivel */
+TreeMap * createTreeMapCompare(int (*compare) (void* key1, void* key2));
+
+/* Mapa de claves char* ordenadas como strcmp. Cada nodo guarda los
+   primeros 8 bytes de su clave, asi la mayoria de las comparaciones no
+   leen el string. */
+TreeMap * createStringTreeMap(void);
+
+/* Mapa autoajustable (splay): searchTreeMap y las inserciones y
+   eliminaciones suben el nodo usado a la raiz, asi las claves mas
+   consultadas quedan cerca de la raiz y en cache. No hay balance AVL: cada
+   operacion cuesta O(log n) amortizado, pero una sola puede costar O(n).
+   lookupTreeMap, las cotas y los cursores no reestructuran el arbol, y no
+   acepta split, join ni operaciones de conjuntos. */
+TreeMap * createSplayTreeMap(int (*lower_than) (void* key1, void* key2));
+
+TreeMap * createSplayTreeMapCompare(int (*compare) (void* key1, void* key2));
+
+/* Mapa respaldado por un B+tree de nodos anchos. Los Pair retornados
+   son validos hasta la siguiente insercion o eliminacion. */
+TreeMap * createBTreeMap(int (*lower_than) (void* key1, void* key2));
+
+TreeMap * createBTreeMapCompare(int (*compare) (void* key1, void* key2));
+
+void destroyTreeMap(TreeMap * tree);
+
+/* Guarda el mapa en path en un formato plano: indice ordenado y datos.
+   encodeKey/encodeValue escriben en buf (de cap bytes) la representacion
+   de la clave o el valor y retornan su largo; si es mayor que cap se
+   vuelven a llamar con un buffer suficiente. Retorna 1 si pudo guardar. */
+int saveTreeMap(TreeMap * tree, const char* path,
+                size_t (*encodeKey) (void* key, void* buf, size_t cap),
+                size_t (*encodeValue) (void* value, void* buf, size_t cap));
+
+/* Abre con mmap un archivo de saveTreeMap como mapa de solo lectura, sin
+   reservar nodos. Las claves y valores de los Pair apuntan a los bytes
+   codificados dentro del archivo (alineados a 8), asi que lower_than debe
+   aceptar esa representacion. El indice se traduce una vez al abrir
+   (O(n), sin leer los datos) y despues el mapa no se modifica, asi que
+   varios hilos pueden usar lookupTreeMap a la vez. Retorna NULL si el
+   archivo esta truncado o algun offset cae fuera de el. Insertar o
+   eliminar no tiene efecto. */
+TreeMap * openTreeMap(const char* path, int (*lower_than) (void* key1, void* key2));
+
+TreeMap * openTreeMapCompare(const char* path, int (*compare) (void* key1, void* key2));
+
 void insertTreeMap(TreeMap * tree, void* key, void * value);
 
+/* Construye en O(n) un arbol perfectamente balanceado a partir de pairs,
+   ordenados por clave y sin repetidos. Si el mapa no esta vacio (o es un
+   B+tree) los pares se insertan uno a uno. */
+void buildTreeMap(TreeMap * tree, Pair * pairs, int n);
+
 void eraseTreeMap(TreeMap * tree, void* key);
 
 Pair * searchTreeMap(TreeMap * tree, void* key);
 
+/* Las cotas retornan el Pair guardado en el mapa (no se debe liberar). */
+
+/* menor clave >= key */
 Pair * upperBound(TreeMap * tree, void* key);
 
+/* menor clave >= key (igual que upperBound) */
+Pair * ceilingTreeMap(TreeMap * tree, void* key);
+
+/* mayor clave <= key */
+Pair * floorTreeMap(TreeMap * tree, void* key);
+
+/* menor clave > key */
+Pair * higherTreeMap(TreeMap * tree, void* key);
+
+/* mayor clave < key */
+Pair * lowerTreeMap(TreeMap * tree, void* key);
+
 Pair * firstTreeMap(TreeMap * tree);
 
 Pair * nextTreeMap(TreeMap * tree);
 
+/* Recorrido hacia atras: lastTreeMap deja current en la mayor clave y
+   prevTreeMap retrocede, igual que firstTreeMap/nextTreeMap. Las
+   ultimas N claves cuestan O(log n + N). */
+Pair * lastTreeMap(TreeMap * tree);
+
+Pair * prevTreeMap(TreeMap * tree);
+
+/* Enhebra el mapa: cada nodo guarda su sucesor y predecesor en orden, y
+   los enlaces se mantienen al insertar, eliminar, construir y combinar
+   mapas. nextTreeMap y los cursores avanzan en O(1) en vez de subir por
+   los padres. Solo los nodos de mapas enhebrados reservan espacio para
+   los enlaces, asi que los nodos existentes se copian a nodos nuevos en
+   O(n) una vez: los Pair y cursores obtenidos antes dejan de ser validos.
+   Un mapa sin enlaces que se une a uno enhebrado se enhebra primero. No
+   tiene efecto en un B+tree (sus hojas ya estan enlazadas) ni en un
+   archivo. */
+void threadTreeMap(TreeMap * tree);
+
+/* Busqueda de solo lectura: a diferencia de searchTreeMap no modifica
+   current, por lo que varios hilos pueden consultar a la vez. */
+Pair * lookupTreeMap(TreeMap * tree, void* key);
+
+/* Agrega al mapa un indice hash de clave a nodo. searchTreeMap,
+   lookupTreeMap, eraseTreeMap y searchBatchTreeMap encuentran la clave en
+   O(1) esperado, sin bajar por el arbol; las cotas, rangos e iteracion
+   siguen usando el orden. hash debe dar el mismo valor para claves
+   iguales. El indice se mantiene al insertar y eliminar; split, join y
+   las operaciones de conjuntos lo rehacen en O(n). No se aplica a B+tree
+   ni archivos. Retorna 0 si no se pudo crear (si despues falta memoria
+   para crecer, el mapa sigue sin indice). */
+int indexTreeMap(TreeMap * tree, unsigned long (*hash) (void* key));
+
+/* Cursor de iteracion cuyo estado pertenece al llamador. Ninguna
+   operacion de cursor escribe en el TreeMap; el cursor queda invalido
+   si se inserta o elimina en el mapa. */
+typedef struct TreeCursor {
+     TreeMap * tree;
+     void * node;
+     int index;
+} TreeCursor;
+
+Pair * firstCursor(TreeCursor * cursor, TreeMap * tree);
+
+Pair * lastCursor(TreeCursor * cursor, TreeMap * tree);
+
+/* posiciona el cursor en la menor clave >= key */
+Pair * seekCursor(TreeCursor * cursor, TreeMap * tree, void* key);
+
+Pair * nextCursor(TreeCursor * cursor);
+
+Pair * prevCursor(TreeCursor * cursor);
+
+Pair * cursorPair(TreeCursor * cursor);
+
+/* Inserta key usando como pista la posicion de hint (por ejemplo la de
+   la insercion anterior). Si key queda junto a esa posicion solo se
+   compara con sus vecinos; si no, se busca desde la raiz. Deja hint en
+   el par de key y lo retorna (el existente si la clave ya estaba). hint
+   puede ser NULL o un cursor en cero ({0}) para la primera insercion, y
+   queda invalido si se elimina una clave del mapa. Cuando la pista
+   acierta hace O(1) comparaciones, pero el tamano de cada ancestro se
+   actualiza hasta la raiz (rankTreeMap y selectTreeMap lo usan): el
+   costo en punteros sigue siendo O(log n). */
+Pair * insertHintTreeMap(TreeMap * tree, TreeCursor * hint, void* key, void * value);
+
+/* cantidad de pares del mapa */
+long sizeTreeMap(TreeMap * tree);
+
+/* cantidad de claves < key; O(log n) */
+long rankTreeMap(TreeMap * tree, void* key);
+
+/* k-esimo par (desde 0) en orden de claves, o NULL; deja current en el
+   par para seguir con nextTreeMap. O(log n) */
+Pair * selectTreeMap(TreeMap * tree, long k);
+
+/* Visita en orden los pares con lo <= key < hi (NULL = sin cota) y
+   retorna cuantos visito. Si visit retorna 0 el recorrido se detiene. */
+long rangeTreeMap(TreeMap * tree, void* lo, void* hi,
+                  int (*visit) (Pair* pair, void* data), void* data);
+
+/* Como rangeTreeMap pero visita los pares de mayor a menor clave. */
+long rangeReverseTreeMap(TreeMap * tree, void* lo, void* hi,
+                         int (*visit) (Pair* pair, void* data), void* data);
+
+/* cantidad de claves en [lo, hi) */
+long countRangeTreeMap(TreeMap * tree, void* lo, void* hi);
+
+/* Operaciones basadas en join: mueven nodos entre mapas AVL con el mismo
+   orden, sin copiarlos ni reinsertarlos (no aceptan B+tree ni archivos).
+   En las operaciones de dos mapas other queda vacio, pero hay que
+   destruirlo igual; si una clave esta en ambos se conserva el par de tree.
+   Con m <= n pares, union, interseccion y diferencia hacen
+   O(m log(n/m + 1)) comparaciones. */
+
+/* Mueve a un mapa nuevo los pares con clave >= key; tree conserva los
+   menores. O(log n) */
+TreeMap * splitTreeMap(TreeMap * tree, void* key);
+
+/* Agrega a tree los pares de other, cuyas claves deben ser todas mayores
+   que las de tree: O(log n). Si no lo son se hace una union. */
+void joinTreeMap(TreeMap * tree, TreeMap * other);
+
+void unionTreeMap(TreeMap * tree, TreeMap * other);
+
+/* deja en tree solo las claves que tambien estan en other */
+void intersectionTreeMap(TreeMap * tree, TreeMap * other);
+
+/* quita de tree las claves que estan en other */
+void differenceTreeMap(TreeMap * tree, TreeMap * other);
+
+/* Busca n claves a la vez intercalando sus descensos con prefetch.
+   out[i] recibe el Pair de keys[i] o NULL; retorna la cantidad de
+   aciertos. No modifica current. */
+int searchBatchTreeMap(TreeMap * tree, void** keys, int n, Pair ** out);
+
+/* Pool de hilos para recorrer y construir mapas en paralelo. El mapa se
+   divide en tramos contiguos de claves (por subarboles, usando sus
+   tamanos) y cada hilo toma tramos de su bloque o roba de otros cuando se
+   queda sin trabajo. threads <= 0 usa un hilo por procesador; el hilo que
+   llama tambien trabaja. Con pool NULL todo corre en el hilo que llama.
+   Mientras se recorre no se debe modificar el mapa; los callbacks corren
+   en varios hilos a la vez. */
+typedef struct TreeMapPool TreeMapPool;
+
+TreeMapPool * createTreeMapPool(int threads);
+
+void destroyTreeMapPool(TreeMapPool * pool);
+
+/* Map-reduce: acc (de accSize bytes) entra con el valor neutro, que se
+   copia a un acumulador por tramo. fold agrega un par a su acumulador
+   (los pares de un tramo llegan en orden) y combine agrega other a acc;
+   los tramos se combinan de menor a mayor clave, asi que combine no
+   necesita ser conmutativo. El resultado queda en acc. Retorna 0 si no
+   hay memoria. */
+int reduceTreeMap(TreeMapPool * pool, TreeMap * tree, void* acc, size_t accSize,
+                  void (*fold) (void* acc, Pair* pair, void* data),
+                  void (*combine) (void* acc, void* other, void* data), void* data);
+
+/* Llama visit con cada par y su posicion en orden (rank, desde 0), por
+   ejemplo para escribir out[rank]. Retorna 0 si no hay memoria. */
+int forEachTreeMap(TreeMapPool * pool, TreeMap * tree,
+                   void (*visit) (Pair* pair, long rank, void* data), void* data);
+
+/* buildTreeMap en paralelo: los niveles de arriba se arman en el hilo que
+   llama y los subarboles de abajo en el pool. */
+void buildParallelTreeMap(TreeMapPool * pool, TreeMap * tree, Pair * pairs, int n);
+
+#ifdef TREEMAP_STATS
+/* Estadisticas del mapa. Solo existen si se compila con -DTREEMAP_STATS
+   (en todos los archivos que incluyan treemap.h); sin esa opcion no se
+   cuenta nada y no hay costo. */
+#define TREEMAP_STATS_DEPTHS 64
+
+typedef struct TreeMapStats {
+    unsigned long long comparisons; //llamadas al comparador
+    unsigned long long allocs;      //nodos reservados
+    unsigned long long frees;       //nodos liberados
+    long entries;
+    int maxDepth;                   //la raiz tiene profundidad 1
+    double avgDepth;                //profundidad promedio de los pares
+    long depthHistogram[TREEMAP_STATS_DEPTHS]; //[d-1]: pares a profundidad d
+    size_t nodeBytes;               //memoria reservada para nodos
+    size_t pairBytes;               //parte de nodeBytes ocupada por pares
+} TreeMapStats;
+
+/* Copia los contadores y recorre el mapa para calcular profundidades y
+   memoria: O(n). */
+void statsTreeMap(TreeMap * tree, TreeMapStats * out);
+
+/* Reinicia los contadores de comparaciones, reservas y liberaciones. */
+void resetStatsTreeMap(TreeMap * tree);
+#endif
+
+/* Mapa para varios hilos: las busquedas no toman locks (los nodos son
+   inmutables y se liberan estilo RCU) y las escrituras se serializan.
+   Las lecturas copian el par encontrado en out y retornan 1 si existe. */
+typedef struct ConcurrentTreeMap ConcurrentTreeMap;
+
+ConcurrentTreeMap * createConcurrentTreeMap(int (*lower_than) (void* key1, void* key2));
+
+void destroyConcurrentTreeMap(ConcurrentTreeMap * map);
+
+void insertConcurrentTreeMap(ConcurrentTreeMap * map, void* key, void * value);
+
+void eraseConcurrentTreeMap(ConcurrentTreeMap * map, void* key);
+
+int searchConcurrentTreeMap(ConcurrentTreeMap * map, void* key, Pair * out);
+
+/* menor clave >= key */
+int upperBoundConcurrentTreeMap(ConcurrentTreeMap * map, void* key, Pair * out);
+
+/* Mapa persistente: cada escritura copia solo el camino modificado
+   (O(log n)) y comparte el resto de los nodos, que son inmutables y se
+   liberan por conteo de referencias. snapshotPersistentTreeMap retorna en
+   O(1) otro mapa con el contenido actual; las escrituras posteriores en
+   cualquiera de los dos no afectan al otro. Una version puede leerse en
+   un hilo mientras otro escribe en otra version, y cada version se
+   libera con destroyPersistentTreeMap. Los Pair retornados son validos
+   mientras exista una version que los contenga. */
+typedef struct PersistentTreeMap PersistentTreeMap;
+
+PersistentTreeMap * createPersistentTreeMap(int (*lower_than) (void* key1, void* key2));
+
+PersistentTreeMap * snapshotPersistentTreeMap(PersistentTreeMap * map);
+
+void destroyPersistentTreeMap(PersistentTreeMap * map);
+
+void insertPersistentTreeMap(PersistentTreeMap * map, void* key, void * value);
+
+void erasePersistentTreeMap(PersistentTreeMap * map, void* key);
+
+Pair * searchPersistentTreeMap(PersistentTreeMap * map, void* key);
+
+/* menor clave >= key */
+Pair * upperBoundPersistentTreeMap(PersistentTreeMap * map, void* key);
+
+long sizePersistentTreeMap(PersistentTreeMap * map);
+
+Pair * firstPersistentTreeMap(PersistentTreeMap * map);
+
+Pair * nextPersistentTreeMap(PersistentTreeMap * map);
+
+/* Mapa especializado para claves enteras de 64 bits: las claves se
+   guardan dentro de nodos anchos (B+tree) y se comparan directamente,
+   sin funcion de comparacion. Las cotas e iteracion siguen la misma
+   semantica que TreeMap y copian el par en out (retornan 1 si existe). */
+typedef struct IntTreeMap IntTreeMap;
+
+typedef struct IntPair {
+     long long key;
+     void * value;
+} IntPair;
+
+IntTreeMap * createIntTreeMap(void);
+
+void destroyIntTreeMap(IntTreeMap * map);
+
+void insertIntTreeMap(IntTreeMap * map, long long key, void * value);
+
+void eraseIntTreeMap(IntTreeMap * map, long long key);
+
+/* retorna el valor asociado a key o NULL */
+void * searchIntTreeMap(IntTreeMap * map, long long key);
+
+int upperBoundIntTreeMap(IntTreeMap * map, long long key, IntPair * out);
+
+int ceilingIntTreeMap(IntTreeMap * map, long long key, IntPair * out);
+
+int floorIntTreeMap(IntTreeMap * map, long long key, IntPair * out);
+
+int higherIntTreeMap(IntTreeMap * map, long long key, IntPair * out);
+
+int lowerIntTreeMap(IntTreeMap * map, long long key, IntPair * out);
+
+int firstIntTreeMap(IntTreeMap * map, IntPair * out);
+
+int nextIntTreeMap(IntTreeMap * map, IntPair * out);
+
+long sizeIntTreeMap(IntTreeMap * map);
+
 #endif /* TREEMAP_h */
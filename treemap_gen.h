@@ -0,0 +1,385 @@
+#ifndef TREEMAP_GEN_h
+#define TREEMAP_GEN_h
+
+#include <stdlib.h>
+
+/* Mapa ordenado generico generado con macros (al estilo de klib/khash).
+   TREEMAP_INIT(name, key_t, value_t, lt) genera un arbol AVL cuyos nodos
+   guardan key_t y value_t directamente y cuya comparacion lt(a, b) (una
+   macro o funcion inline que retorna a < b) se compila dentro de los
+   ciclos de busqueda, insercion y eliminacion.
+
+   Ejemplo:
+       #define int_lt(a, b) ((a) < (b))
+       TREEMAP_INIT(imap, int, char*, int_lt)
+
+       imap_t* m = imap_create();
+       imap_put(m, 5, "cinco");
+       imap_node_t* n = imap_get(m, 5);
+       for (n = imap_first(m); n != NULL; n = imap_next(n)) ...
+
+   Funciones generadas (prefijo name_):
+       create, destroy, size, put (1 si inserta, 0 si la clave existia),
+       get, del (1 si elimina), upper_bound (menor clave >= key),
+       lower_bound (mayor clave <= key), first, last, next, prev, select
+       (k-esima clave en orden, desde 0).
+
+   La parte del AVL que no compara claves la genera TREEMAP_AVL_INIT, que
+   tambien usa TreeMap (treemap.c) sobre sus propios nodos. */
+
+/* Capa estructural, intrusiva (al estilo de <sys/tree.h>):
+   TREEMAP_AVL_INIT(name, map_t, node_t) genera las operaciones del AVL
+   para cualquier node_t con campos left, right, parent, height (altura
+   del subarbol) y size (cantidad de nodos del subarbol), y cualquier
+   map_t con campo root. No reserva ni libera nodos.
+
+   Funciones generadas (prefijo name_):
+       height, count (tamano del subarbol; 0 si es NULL), update, replace,
+       rotate_left, rotate_right, rebalance (delta: +1 al insertar, -1 al
+       eliminar), attach (cuelga un nodo nuevo, sin rebalancear), unlink
+       (saca un nodo con a lo mas un hijo y retorna su padre), min, max,
+       next, prev, select, join (arbol con l < k < r, O(|h(l) - h(r)|)),
+       split_last y join_two. join y los que lo usan arman subarboles
+       sueltos: el llamador fija el padre de la raiz. */
+
+#define TREEMAP_AVL_INIT(name, map_t, node_t)                                  \
+                                                                               \
+static inline int name##_height(node_t * x) {                                  \
+    return x == NULL ? 0 : x->height;                                          \
+}                                                                              \
+                                                                               \
+static inline int name##_count(node_t * x) {                                   \
+    return x == NULL ? 0 : x->size;                                            \
+}                                                                              \
+                                                                               \
+/* recalcula altura y tamano a partir de los hijos */                          \
+static inline void name##_update(node_t * x) {                                 \
+    int hl = name##_height(x->left), hr = name##_height(x->right);             \
+    x->height = 1 + (hl > hr ? hl : hr);                                       \
+    x->size = 1 + name##_count(x->left) + name##_count(x->right);              \
+}                                                                              \
+                                                                               \
+/* reemplaza el hijo old de parent por new (o la raiz si parent es NULL) */    \
+static inline void name##_replace(map_t * map, node_t * parent,                \
+                                  node_t * old, node_t * new) {                \
+    if (parent == NULL) map->root = new;                                       \
+    else if (parent->left == old) parent->left = new;                          \
+    else parent->right = new;                                                  \
+    if (new != NULL) new->parent = parent;                                     \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_rotate_left(map_t * map, node_t * x) {           \
+    node_t * y = x->right;                                                     \
+    name##_replace(map, x->parent, x, y);                                      \
+    x->right = y->left;                                                        \
+    if (y->left != NULL) y->left->parent = x;                                  \
+    y->left = x;                                                               \
+    x->parent = y;                                                             \
+    name##_update(x);                                                          \
+    name##_update(y);                                                          \
+    return y;                                                                  \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_rotate_right(map_t * map, node_t * x) {          \
+    node_t * y = x->left;                                                      \
+    name##_replace(map, x->parent, x, y);                                      \
+    x->left = y->right;                                                        \
+    if (y->right != NULL) y->right->parent = x;                                \
+    y->right = x;                                                              \
+    x->parent = y;                                                             \
+    name##_update(x);                                                          \
+    name##_update(y);                                                          \
+    return y;                                                                  \
+}                                                                              \
+                                                                               \
+/* sube desde x recalculando y rotando. Si la altura de un subarbol no      */ \
+/* cambia, los de arriba siguen balanceados: solo se suma delta al tamano   */ \
+/* (ese ultimo tramo igual llega a la raiz, O(log n) pasos)                 */ \
+static inline void name##_rebalance(map_t * map, node_t * x, int delta) {      \
+    while (x != NULL) {                                                        \
+        int before = x->height;                                                \
+        name##_update(x);                                                      \
+        int balance = name##_height(x->left) - name##_height(x->right);        \
+        if (balance > 1) {                                                     \
+            if (name##_height(x->left->left) < name##_height(x->left->right))  \
+                name##_rotate_left(map, x->left);                              \
+            x = name##_rotate_right(map, x);                                   \
+        } else if (balance < -1) {                                             \
+            if (name##_height(x->right->right) < name##_height(x->right->left))\
+                name##_rotate_right(map, x->right);                            \
+            x = name##_rotate_left(map, x);                                    \
+        }                                                                      \
+        if (x->height == before) {                                             \
+            for (x = x->parent; x != NULL; x = x->parent) x->size += delta;    \
+            return;                                                            \
+        }                                                                      \
+        x = x->parent;                                                         \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline void name##_attach(map_t * map, node_t * parent, int goLeft,     \
+                                 node_t * node) {                              \
+    node->parent = parent;                                                     \
+    if (parent == NULL) map->root = node;                                      \
+    else if (goLeft) parent->left = node;                                      \
+    else parent->right = node;                                                 \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_unlink(map_t * map, node_t * node) {             \
+    node_t * child = node->left != NULL ? node->left : node->right;            \
+    node_t * parent = node->parent;                                            \
+    name##_replace(map, parent, node, child);                                  \
+    return parent;                                                             \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_min(node_t * x) {                                \
+    while (x != NULL && x->left != NULL) x = x->left;                          \
+    return x;                                                                  \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_max(node_t * x) {                                \
+    while (x != NULL && x->right != NULL) x = x->right;                        \
+    return x;                                                                  \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_next(node_t * x) {                               \
+    if (x->right != NULL) return name##_min(x->right);                         \
+    while (x->parent != NULL && x == x->parent->right) x = x->parent;          \
+    return x->parent;                                                          \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_prev(node_t * x) {                               \
+    if (x->left != NULL) return name##_max(x->left);                           \
+    while (x->parent != NULL && x == x->parent->left) x = x->parent;           \
+    return x->parent;                                                          \
+}                                                                              \
+                                                                               \
+/* k-esimo nodo en orden (desde 0) del subarbol x */                           \
+static inline node_t * name##_select(node_t * x, long k) {                     \
+    while (x != NULL) {                                                        \
+        long left = name##_count(x->left);                                     \
+        if (k < left) x = x->left;                                             \
+        else if (k > left) { k -= left + 1; x = x->right; }                    \
+        else break;                                                            \
+    }                                                                          \
+    return x;                                                                  \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_graft(node_t * k, node_t * left,                 \
+                                    node_t * right) {                          \
+    k->left = left;                                                            \
+    k->right = right;                                                          \
+    if (left != NULL) left->parent = k;                                        \
+    if (right != NULL) right->parent = k;                                      \
+    name##_update(k);                                                          \
+    return k;                                                                  \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_spin_left(node_t * x) {                          \
+    node_t * y = x->right;                                                     \
+    return name##_graft(y, name##_graft(x, x->left, y->left), y->right);       \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_spin_right(node_t * x) {                         \
+    node_t * y = x->left;                                                      \
+    return name##_graft(y, y->left, name##_graft(x, y->right, x->right));      \
+}                                                                              \
+                                                                               \
+/* l mas alto que r: baja por la rama derecha de l hasta una altura         */ \
+/* compatible con r y cuelga ahi (c, k, r), rotando al subir                */ \
+static inline node_t * name##_join_right(node_t * l, node_t * k, node_t * r) { \
+    node_t * t;                                                                \
+    if (name##_height(l->right) <= name##_height(r) + 1) {                     \
+        t = name##_graft(k, l->right, r);                                      \
+        if (name##_height(t) <= name##_height(l->left) + 1)                    \
+            return name##_graft(l, l->left, t);                                \
+        t = name##_graft(l, l->left, name##_spin_right(t));                    \
+        return name##_spin_left(t);                                            \
+    }                                                                          \
+    t = name##_join_right(l->right, k, r);                                     \
+    name##_graft(l, l->left, t);                                               \
+    return name##_height(t) <= name##_height(l->left) + 1                      \
+        ? l : name##_spin_left(l);                                             \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_join_left(node_t * l, node_t * k, node_t * r) {  \
+    node_t * t;                                                                \
+    if (name##_height(r->left) <= name##_height(l) + 1) {                      \
+        t = name##_graft(k, l, r->left);                                       \
+        if (name##_height(t) <= name##_height(r->right) + 1)                   \
+            return name##_graft(r, t, r->right);                               \
+        t = name##_graft(r, name##_spin_left(t), r->right);                    \
+        return name##_spin_right(t);                                           \
+    }                                                                          \
+    t = name##_join_left(l, k, r->left);                                       \
+    name##_graft(r, t, r->right);                                              \
+    return name##_height(t) <= name##_height(r->right) + 1                     \
+        ? r : name##_spin_right(r);                                            \
+}                                                                              \
+                                                                               \
+static inline node_t * name##_join(node_t * l, node_t * k, node_t * r) {       \
+    node_t * t;                                                                \
+    if (name##_height(l) > name##_height(r) + 1)                               \
+        t = name##_join_right(l, k, r);                                        \
+    else if (name##_height(r) > name##_height(l) + 1)                          \
+        t = name##_join_left(l, k, r);                                         \
+    else t = name##_graft(k, l, r);                                            \
+    t->parent = NULL;                                                          \
+    return t;                                                                  \
+}                                                                              \
+                                                                               \
+/* separa el nodo maximo de t; retorna el resto */                             \
+static inline node_t * name##_split_last(node_t * t, node_t ** last) {         \
+    if (t->right == NULL) {                                                    \
+        *last = t;                                                             \
+        if (t->left != NULL) t->left->parent = NULL;                           \
+        return t->left;                                                        \
+    }                                                                          \
+    node_t * rest = name##_split_last(t->right, last);                         \
+    return name##_join(t->left, t, rest);                                      \
+}                                                                              \
+                                                                               \
+/* join sin nodo intermedio (l < r) */                                         \
+static inline node_t * name##_join_two(node_t * l, node_t * r) {               \
+    if (l == NULL) return r;                                                   \
+    if (r == NULL) return l;                                                   \
+    node_t * k;                                                                \
+    l = name##_split_last(l, &k);                                              \
+    return name##_join(l, k, r);                                               \
+}
+
+#define TREEMAP_INIT(name, key_t, value_t, lt)                                 \
+                                                                               \
+typedef struct name##_node_t name##_node_t;                                    \
+                                                                               \
+struct name##_node_t {                                                         \
+    key_t key;                                                                 \
+    value_t value;                                                             \
+    name##_node_t * left;                                                      \
+    name##_node_t * right;                                                     \
+    name##_node_t * parent;                                                    \
+    int height;                                                                \
+    int size;                                                                  \
+};                                                                             \
+                                                                               \
+typedef struct name##_t {                                                      \
+    name##_node_t * root;                                                      \
+} name##_t;                                                                    \
+                                                                               \
+TREEMAP_AVL_INIT(name##_avl, name##_t, name##_node_t)                          \
+                                                                               \
+static inline name##_t * name##_create(void) {                                 \
+    return (name##_t *)calloc(1, sizeof(name##_t));                            \
+}                                                                              \
+                                                                               \
+static inline void name##_free_subtree(name##_node_t * x) {                    \
+    while (x != NULL) {                                                        \
+        name##_node_t * right = x->right;                                      \
+        name##_free_subtree(x->left);                                          \
+        free(x);                                                               \
+        x = right;                                                             \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline void name##_destroy(name##_t * map) {                            \
+    if (map == NULL) return;                                                   \
+    name##_free_subtree(map->root);                                            \
+    free(map);                                                                 \
+}                                                                              \
+                                                                               \
+static inline long name##_size(name##_t * map) {                               \
+    return name##_avl_count(map->root);                                        \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_get(name##_t * map, key_t key) {          \
+    name##_node_t * x = map->root;                                             \
+    name##_node_t * candidate = NULL;                                          \
+    while (x != NULL) {                                                        \
+        if (lt(x->key, key)) x = x->right;                                     \
+        else { candidate = x; x = x->left; }                                   \
+    }                                                                          \
+    if (candidate != NULL && !lt(key, candidate->key)) return candidate;       \
+    return NULL;                                                               \
+}                                                                              \
+                                                                               \
+static inline int name##_put(name##_t * map, key_t key, value_t value) {       \
+    name##_node_t * x = map->root;                                             \
+    name##_node_t * parent = NULL;                                             \
+    name##_node_t * candidate = NULL;                                          \
+    int goLeft = 0;                                                            \
+    while (x != NULL) {                                                        \
+        parent = x;                                                            \
+        goLeft = lt(key, x->key);                                              \
+        if (!goLeft) candidate = x;                                            \
+        x = goLeft ? x->left : x->right;                                       \
+    }                                                                          \
+    if (candidate != NULL && !lt(candidate->key, key)) return 0;               \
+                                                                               \
+    name##_node_t * node = (name##_node_t *)malloc(sizeof(name##_node_t));     \
+    if (node == NULL) return 0;                                                \
+    node->key = key;                                                           \
+    node->value = value;                                                       \
+    node->left = node->right = NULL;                                           \
+    node->height = 1;                                                          \
+    node->size = 1;                                                            \
+    name##_avl_attach(map, parent, goLeft, node);                              \
+    name##_avl_rebalance(map, parent, 1);                                      \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_first(name##_t * map) {                   \
+    return name##_avl_min(map->root);                                          \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_last(name##_t * map) {                    \
+    return name##_avl_max(map->root);                                          \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_next(name##_node_t * x) {                 \
+    return name##_avl_next(x);                                                 \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_prev(name##_node_t * x) {                 \
+    return name##_avl_prev(x);                                                 \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_select(name##_t * map, long k) {          \
+    return name##_avl_select(map->root, k);                                    \
+}                                                                              \
+                                                                               \
+static inline int name##_del(name##_t * map, key_t key) {                      \
+    name##_node_t * node = name##_get(map, key);                               \
+    if (node == NULL) return 0;                                                \
+    if (node->left != NULL && node->right != NULL) {                           \
+        name##_node_t * succ = name##_avl_min(node->right);                    \
+        node->key = succ->key;                                                 \
+        node->value = succ->value;                                             \
+        node = succ;                                                           \
+    }                                                                          \
+    name##_node_t * parent = name##_avl_unlink(map, node);                     \
+    free(node);                                                                \
+    name##_avl_rebalance(map, parent, -1);                                     \
+    return 1;                                                                  \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_upper_bound(name##_t * map, key_t key) {  \
+    name##_node_t * x = map->root;                                             \
+    name##_node_t * candidate = NULL;                                          \
+    while (x != NULL) {                                                        \
+        if (lt(x->key, key)) x = x->right;                                     \
+        else { candidate = x; x = x->left; }                                   \
+    }                                                                          \
+    return candidate;                                                          \
+}                                                                              \
+                                                                               \
+static inline name##_node_t * name##_lower_bound(name##_t * map, key_t key) {  \
+    name##_node_t * x = map->root;                                             \
+    name##_node_t * candidate = NULL;                                          \
+    while (x != NULL) {                                                        \
+        if (lt(key, x->key)) x = x->left;                                      \
+        else { candidate = x; x = x->right; }                                  \
+    }                                                                          \
+    return candidate;                                                          \
+}
+
+#endif /* TREEMAP_GEN_h */